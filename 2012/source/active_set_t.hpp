@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * icfp/2012/source/active_set_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_ACTIVE_SET_T_HPP
+#define ICFP_2012_SOURCE_ACTIVE_SET_T_HPP
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <iterator>
+
+#include <boost/cstdint.hpp>
+
+#include "index_t.hpp"
+#include "update_compare_t.hpp"
+
+namespace icfp2012
+{
+
+// A set of cells kept in update_compare_t order (the order in which the world
+// update visits them), as a sorted array.  The first n_inline cells are stored
+// within the set itself, so the few active cells of most states need no heap
+// allocation.
+class active_set_t
+{
+public:
+    typedef index_t value_type;
+    typedef index_t const * iterator;
+    typedef index_t const * const_iterator;
+    typedef std::size_t size_type;
+
+    static std::size_t const n_inline = 16;
+
+    active_set_t();
+    active_set_t(active_set_t const & other);
+    ~active_set_t();
+
+    active_set_t& operator=(active_set_t const & other);
+    void swap(active_set_t& other);
+    inline friend void
+    swap(active_set_t& this_, active_set_t& other)
+    { this_.swap(other); }
+
+    const_iterator begin() const
+    { return data; }
+    const_iterator end() const
+    { return data + n; }
+
+    std::size_t size() const
+    { return n; }
+    bool empty() const
+    { return n == 0; }
+
+    index_t operator[](std::size_t const k) const
+    {
+        assert(k < n);
+        return data[k];
+    }
+
+    // Returns false, leaving the set as is, if index is already in it.
+    bool insert(index_t const index);
+    // Replaces the cells with those of [first, last), which must be in
+    // update_compare_t order and distinct.
+    template< class It >
+    void assign(It first, It const last);
+    void clear()
+    { n = 0; }
+
+    bool operator==(active_set_t const & other) const
+    { return n == other.n && std::equal(begin(), end(), other.begin()); }
+    bool operator!=(active_set_t const & other) const
+    { return !operator==(other); }
+
+private:
+    index_t* data;
+    boost::uint32_t n;
+    boost::uint32_t capacity;
+    index_t inline_data[n_inline];
+
+    bool is_inline() const
+    { return data == inline_data; }
+    void reserve(std::size_t const min_capacity);
+};
+
+/*******************************************************************************
+ ******************************************************************************/
+
+inline
+active_set_t::
+active_set_t()
+    : data(inline_data),
+      n(0),
+      capacity(n_inline)
+{ }
+
+inline
+active_set_t::
+active_set_t(active_set_t const & other)
+    : data(inline_data),
+      n(0),
+      capacity(n_inline)
+{ *this = other; }
+
+inline
+active_set_t::
+~active_set_t()
+{
+    if(!is_inline())
+        delete [] data;
+}
+
+inline active_set_t&
+active_set_t::
+operator=(active_set_t const & other)
+{
+    if(this != &other) {
+        reserve(other.n);
+        std::copy(other.begin(), other.end(), data);
+        n = other.n;
+    }
+    return *this;
+}
+
+inline void
+active_set_t::
+swap(active_set_t& other)
+{
+    if(is_inline() && other.is_inline())
+        std::swap_ranges(inline_data, inline_data + n_inline, other.inline_data);
+    else if(is_inline()) {
+        std::copy(inline_data, inline_data + n, other.inline_data);
+        data = other.data;
+        other.data = other.inline_data;
+    }
+    else if(other.is_inline()) {
+        std::copy(other.inline_data, other.inline_data + other.n, inline_data);
+        other.data = data;
+        data = inline_data;
+    }
+    else
+        std::swap(data, other.data);
+    std::swap(n, other.n);
+    std::swap(capacity, other.capacity);
+}
+
+inline bool
+active_set_t::
+insert(index_t const index)
+{
+    index_t* const it =
+        std::lower_bound(data, data + n, index, update_compare_t());
+    if(it != data + n && *it == index)
+        return false;
+    std::size_t const k = it - data;
+    reserve(n + 1);
+    std::copy_backward(data + k, data + n, data + n + 1);
+    data[k] = index;
+    ++n;
+    return true;
+}
+
+template< class It >
+inline void
+active_set_t::
+assign(It first, It const last)
+{
+    n = 0;
+    reserve(std::distance(first, last));
+    for(; first != last; ++first) {
+        assert(n == 0 || update_compare_t()(data[n-1], *first));
+        data[n++] = *first;
+    }
+}
+
+inline void
+active_set_t::
+reserve(std::size_t const min_capacity)
+{
+    if(min_capacity <= capacity)
+        return;
+    std::size_t const new_capacity =
+        std::max< std::size_t >(min_capacity, 2 * capacity);
+    index_t* const new_data = new index_t[new_capacity];
+    std::copy(data, data + n, new_data);
+    if(!is_inline())
+        delete [] data;
+    data = new_data;
+    capacity = static_cast< boost::uint32_t >(new_capacity);
+}
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_ACTIVE_SET_T_HPP
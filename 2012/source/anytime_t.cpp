@@ -0,0 +1,118 @@
+/*******************************************************************************
+ * icfp/2012/source/anytime_t.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <csignal>
+
+#include <deque>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "anytime_t.hpp"
+
+namespace icfp2012
+{
+
+namespace
+{
+
+// Only a volatile sig_atomic_t may be written from a signal handler; the
+// route itself is written out by the thread which notices the flag.
+volatile std::sig_atomic_t is_interrupted = 0;
+
+extern "C" void on_sigint(int)
+{ is_interrupted = 1; }
+
+boost::posix_time::ptime deadline_from_now(double const seconds)
+{
+    if(seconds <= 0)
+        return boost::posix_time::ptime(boost::posix_time::pos_infin);
+    return boost::posix_time::microsec_clock::universal_time()
+         + boost::posix_time::microseconds(
+               static_cast< long >(seconds * 1000000));
+}
+
+} // namespace
+
+/*******************************************************************************
+ * anytime_t::anytime_t(double const seconds)
+ ******************************************************************************/
+
+anytime_t::
+anytime_t(double const seconds /*= 0*/)
+    : deadline(deadline_from_now(seconds)),
+      old_handler(std::signal(SIGINT, &on_sigint)),
+      best_score_(0)
+{ }
+
+/*******************************************************************************
+ * anytime_t::~anytime_t()
+ ******************************************************************************/
+
+anytime_t::
+~anytime_t()
+{
+    if(old_handler != SIG_ERR)
+        std::signal(SIGINT, old_handler);
+}
+
+/*******************************************************************************
+ * anytime_t::is_expired() const -> bool
+ ******************************************************************************/
+
+bool
+anytime_t::
+is_expired() const
+{
+    return is_interrupted != 0
+        || (!deadline.is_pos_infinity()
+         && boost::posix_time::microsec_clock::universal_time() >= deadline);
+}
+
+/*******************************************************************************
+ * anytime_t::offer(std::deque< char > const & path, int const score) -> bool
+ ******************************************************************************/
+
+bool
+anytime_t::
+offer(std::deque< char > const & path, int const score)
+{
+    boost::lock_guard< boost::mutex > lock(mutex);
+    if(score <= best_score_)
+        return false;
+    best_path_ = path;
+    best_score_ = score;
+    return true;
+}
+
+/*******************************************************************************
+ * anytime_t::best_score() const -> int
+ ******************************************************************************/
+
+int
+anytime_t::
+best_score() const
+{
+    boost::lock_guard< boost::mutex > lock(mutex);
+    return best_score_;
+}
+
+/*******************************************************************************
+ * anytime_t::best_path() const -> std::deque< char >
+ ******************************************************************************/
+
+std::deque< char >
+anytime_t::
+best_path() const
+{
+    boost::lock_guard< boost::mutex > lock(mutex);
+    return best_path_;
+}
+
+} // namespace icfp2012
@@ -0,0 +1,58 @@
+/*******************************************************************************
+ * icfp/2012/source/anytime_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_ANYTIME_T_HPP
+#define ICFP_2012_SOURCE_ANYTIME_T_HPP
+
+#include <csignal>
+
+#include <deque>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace icfp2012
+{
+
+// The state shared between an anytime search and whoever is waiting on it:
+// the best route found so far, and when the search has to stop.  Searches
+// offer each improved route as they find it and poll is_expired, returning
+// as soon as it is true.  The search stops at the deadline, if any, or once
+// SIGINT arrives, whichever is first.
+class anytime_t
+{
+public:
+    // A deadline of 0 seconds means none.  Installs the SIGINT handler.
+    explicit anytime_t(double const seconds = 0);
+    ~anytime_t();
+
+    bool is_expired() const;
+
+    // Keeps path, a route from the start of the search scoring score, if it
+    // scores higher than the best route so far, and returns whether it did.
+    // Safe to call concurrently.
+    bool offer(std::deque< char > const & path, int const score);
+
+    int best_score() const;
+    std::deque< char > best_path() const;
+
+private:
+    anytime_t(anytime_t const &);
+    anytime_t& operator=(anytime_t const &);
+
+    boost::posix_time::ptime const deadline;
+    void (*old_handler)(int);
+
+    mutable boost::mutex mutex;
+    std::deque< char > best_path_;
+    int best_score_;
+};
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_ANYTIME_T_HPP
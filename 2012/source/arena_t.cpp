@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * icfp/2012/source/arena_t.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <new>
+
+#include "arena_t.hpp"
+
+namespace icfp2012
+{
+
+/*******************************************************************************
+ * arena_t::release() -> void
+ ******************************************************************************/
+
+void
+arena_t::
+release()
+{
+    while(blocks) {
+        block_t* const next = blocks->next;
+        ::operator delete(blocks);
+        blocks = next;
+    }
+    first = last = 0;
+    std::fill(
+        free_lists, free_lists + n_free_lists,
+        static_cast< chunk_t* >(0));
+    stats_ = stats_t();
+}
+
+/*******************************************************************************
+ * arena_t::allocate_block(std::size_t const size) -> void*
+ *
+ * Allocations too large to waste the remainder of the current block on get a
+ * block of their own, and the current block continues to be carved up.
+ ******************************************************************************/
+
+void*
+arena_t::
+allocate_block(std::size_t const size)
+{
+    std::size_t const header_size =
+        (sizeof( block_t ) + alignment - 1) & ~(alignment - 1);
+    bool const is_large = size > block_size / 4;
+    std::size_t const n_bytes = header_size + (is_large ? size : block_size);
+    block_t* const block = static_cast< block_t* >(::operator new(n_bytes));
+    block->next = blocks;
+    blocks = block;
+    ++stats_.n_blocks;
+    stats_.n_bytes_reserved += n_bytes;
+    char* const p = reinterpret_cast< char* >(block) + header_size;
+    if(!is_large) {
+        first = p + size;
+        last = p + block_size;
+    }
+    return p;
+}
+
+} // namespace icfp2012
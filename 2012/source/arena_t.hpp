@@ -0,0 +1,214 @@
+/*******************************************************************************
+ * icfp/2012/source/arena_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_ARENA_T_HPP
+#define ICFP_2012_SOURCE_ARENA_T_HPP
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <limits>
+#include <new>
+
+namespace icfp2012
+{
+
+// A region allocator: memory is carved sequentially out of large blocks and
+// is only returned to the system all at once, when the arena is released or
+// destroyed.  Addresses are stable for the lifetime of the arena.  Small
+// deallocated chunks are kept on per-size free lists and reused by later
+// allocations of the same size.
+class arena_t
+{
+public:
+    struct stats_t
+    {
+        std::size_t n_allocations;
+        std::size_t n_reuses;
+        std::size_t n_bytes_allocated;
+        std::size_t n_blocks;
+        std::size_t n_bytes_reserved;
+        stats_t();
+    };
+
+    explicit arena_t(std::size_t const block_size = 1 << 20);
+    ~arena_t();
+
+    void* allocate(std::size_t size);
+    void deallocate(void* const p, std::size_t size);
+    void release();
+
+    stats_t const & stats() const;
+
+private:
+    arena_t(arena_t const &);
+    arena_t& operator=(arena_t const &);
+
+    struct block_t
+    {
+        block_t* next;
+    };
+
+    struct chunk_t
+    {
+        chunk_t* next;
+    };
+
+    static std::size_t const alignment = 2 * sizeof( void* );
+    static std::size_t const n_free_lists = 32;
+
+    std::size_t const block_size;
+    block_t* blocks;
+    char* first;
+    char* last;
+    // free_lists[k] holds deallocated chunks of (k+1) * alignment bytes.
+    chunk_t* free_lists[n_free_lists];
+    stats_t stats_;
+
+    static std::size_t round_up(std::size_t const size);
+
+    void* allocate_block(std::size_t const size);
+};
+
+// An allocator for standard containers which allocates from an arena_t.
+template< class T >
+class arena_allocator_t
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef T const * const_pointer;
+    typedef T& reference;
+    typedef T const & const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template< class U >
+    struct rebind
+    { typedef arena_allocator_t< U > other; };
+
+    explicit arena_allocator_t(arena_t& arena_)
+        : arena(&arena_)
+    { }
+
+    template< class U >
+    arena_allocator_t(arena_allocator_t< U > const & other)
+        : arena(other.arena)
+    { }
+
+    pointer address(reference x) const
+    { return &x; }
+    const_pointer address(const_reference x) const
+    { return &x; }
+
+    pointer allocate(size_type const n, void const * = 0)
+    { return static_cast< pointer >(arena->allocate(n * sizeof( T ))); }
+    void deallocate(pointer p, size_type const n)
+    { arena->deallocate(p, n * sizeof( T )); }
+
+    size_type max_size() const
+    { return std::numeric_limits< size_type >::max() / sizeof( T ); }
+
+    void construct(pointer p, T const & x)
+    { new(static_cast< void* >(p)) T(x); }
+    void destroy(pointer p)
+    { p->~T(); }
+
+    template< class U >
+    bool operator==(arena_allocator_t< U > const & other) const
+    { return arena == other.arena; }
+    template< class U >
+    bool operator!=(arena_allocator_t< U > const & other) const
+    { return arena != other.arena; }
+
+private:
+    template< class > friend class arena_allocator_t;
+    arena_t* arena;
+};
+
+/*******************************************************************************
+ ******************************************************************************/
+
+inline
+arena_t::stats_t::
+stats_t()
+    : n_allocations(0),
+      n_reuses(0),
+      n_bytes_allocated(0),
+      n_blocks(0),
+      n_bytes_reserved(0)
+{ }
+
+inline
+arena_t::
+arena_t(std::size_t const block_size_)
+    : block_size(block_size_),
+      blocks(0),
+      first(0),
+      last(0)
+{
+    std::fill(
+        free_lists, free_lists + n_free_lists,
+        static_cast< chunk_t* >(0));
+}
+
+inline
+arena_t::
+~arena_t()
+{ release(); }
+
+inline std::size_t
+arena_t::
+round_up(std::size_t const size)
+{ return size == 0 ? alignment : (size + alignment - 1) & ~(alignment - 1); }
+
+inline void*
+arena_t::
+allocate(std::size_t size)
+{
+    size = round_up(size);
+    ++stats_.n_allocations;
+    stats_.n_bytes_allocated += size;
+    std::size_t const k = size / alignment - 1;
+    if(k < n_free_lists && free_lists[k]) {
+        chunk_t* const chunk = free_lists[k];
+        free_lists[k] = chunk->next;
+        ++stats_.n_reuses;
+        return chunk;
+    }
+    if(static_cast< std::size_t >(last - first) < size)
+        return allocate_block(size);
+    void* const p = first;
+    first += size;
+    return p;
+}
+
+inline void
+arena_t::
+deallocate(void* const p, std::size_t size)
+{
+    if(!p)
+        return;
+    size = round_up(size);
+    std::size_t const k = size / alignment - 1;
+    if(k >= n_free_lists)
+        return;
+    chunk_t* const chunk = static_cast< chunk_t* >(p);
+    chunk->next = free_lists[k];
+    free_lists[k] = chunk;
+}
+
+inline arena_t::stats_t const &
+arena_t::
+stats() const
+{ return stats_; }
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_ARENA_T_HPP
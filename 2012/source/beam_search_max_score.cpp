@@ -0,0 +1,192 @@
+/*******************************************************************************
+ * icfp/2012/source/beam_search_max_score.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "anytime_t.hpp"
+#include "arena_t.hpp"
+#include "beam_search_max_score.hpp"
+#include "bfs.hpp"
+#include "delta_t.hpp"
+#include "index_t.hpp"
+
+namespace icfp2012
+{
+
+namespace
+{
+
+// How a state kept in the beam was reached: its predecessor's position in
+// the previous turn's beam, and the move from there.
+struct link_t
+{
+    boost::uint32_t parent;
+    char move;
+
+    link_t(boost::uint32_t const parent_, char const move_)
+        : parent(parent_),
+          move(move_)
+    { }
+};
+
+struct candidate_t
+{
+    int value;
+    std::size_t order;
+
+    candidate_t(int const value_, std::size_t const order_)
+        : value(value_),
+          order(order_)
+    { }
+
+    // Highest value first, then first in.
+    bool operator<(candidate_t const & other) const
+    {
+        return value > other.value
+            || (value == other.value && order < other.order);
+    }
+};
+
+// The route to the successor by move of links.back()[k].
+void path_to(
+    std::vector< std::vector< link_t > > const & links,
+    std::size_t k,
+    char const move,
+    std::deque< char >& path)
+{
+    path.clear();
+    path.push_front(move);
+    for(std::size_t t = links.size(); t != 1;) {
+        link_t const link = links[--t][k];
+        path.push_front(link.move);
+        k = link.parent;
+    }
+}
+
+} // namespace
+
+/*******************************************************************************
+ * beam_evaluate_score(delta_t const & state) -> int
+ ******************************************************************************/
+
+int
+beam_evaluate_score(delta_t const & state)
+{ return state.score(); }
+
+/*******************************************************************************
+ * beam_search_max_score(
+ *     delta_t const & start,
+ *     std::deque< char >& path,
+ *     std::size_t const beam_width,
+ *     std::size_t const max_per_robot_index,
+ *     beam_evaluate_t const & evaluate,
+ *     anytime_t* const anytime)
+ *     -> void
+ ******************************************************************************/
+
+void
+beam_search_max_score(
+    delta_t const & start,
+    std::deque< char >& path,
+    std::size_t const beam_width,
+    std::size_t const max_per_robot_index /*=
+        std::numeric_limits< std::size_t >::max()*/,
+    beam_evaluate_t const & evaluate /*= &beam_evaluate_score*/,
+    anytime_t* const anytime /*= 0*/)
+{
+    assert(beam_width != 0);
+
+    arena_t arena;
+    std::vector< delta_t > beam(1, start);
+    beam.back().cell_map.set_arena(&arena);
+    // links[t][k] leads to beam[k] of turn t; links[0] holds the start alone.
+    std::vector< std::vector< link_t > > links(1);
+    links.back().push_back(link_t(0, 0));
+
+    std::vector< delta_t > successors;
+    std::vector< link_t > successor_links;
+    std::vector< candidate_t > candidates;
+    boost::unordered_set< boost::uint64_t > hashes;
+    boost::unordered_map< index_t, std::size_t > n_per_robot_index;
+    beam.reserve(beam_width);
+    successors.reserve(bfs_detail::n_moves * beam_width);
+
+    int best_score = start.score();
+    path.clear();
+    std::size_t const max_turns = start.base.n_rows * start.base.n_cols;
+
+    for(std::size_t t = 0; t != max_turns && !beam.empty(); ++t) {
+        if(anytime && anytime->is_expired())
+            break;
+
+        for(std::size_t k = 0; k != beam.size(); ++k) {
+            delta_t const & current = beam[k];
+            for(std::size_t i = 0; i != bfs_detail::n_moves; ++i) {
+                char const move = bfs_detail::moves[i];
+                if(!current.move_is_valid(move))
+                    continue;
+                delta_t next = current.move_robot_update(move);
+                if(next.robot_is_destroyed)
+                    continue;
+                int const score = next.score();
+                if(score > best_score) {
+                    best_score = score;
+                    path_to(links, k, move, path);
+                    if(anytime)
+                        anytime->offer(path, score);
+                }
+                // Nothing follows entering the lift.
+                if(next.robot_index == next.base.lift_index)
+                    continue;
+                candidates.push_back(candidate_t(
+                    evaluate(next), successors.size()));
+                successors.push_back(delta_t(start.base, 0));
+                successors.back().swap(next);
+                successor_links.push_back(
+                    link_t(static_cast< boost::uint32_t >(k), move));
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end());
+        beam.clear();
+        links.push_back(std::vector< link_t >());
+        std::vector< link_t >& beam_links = links.back();
+        for(std::size_t c = 0;
+            c != candidates.size() && beam.size() != beam_width;
+            ++c) {
+            std::size_t const k = candidates[c].order;
+            delta_t& successor = successors[k];
+            if(!hashes.insert(successor.full_hash()).second)
+                continue;
+            std::size_t& n = n_per_robot_index[successor.robot_index];
+            if(n == max_per_robot_index)
+                continue;
+            ++n;
+            beam.push_back(delta_t(start.base, 0));
+            beam.back().swap(successor);
+            beam_links.push_back(successor_links[k]);
+        }
+
+        successors.clear();
+        successor_links.clear();
+        candidates.clear();
+        hashes.clear();
+        n_per_robot_index.clear();
+    }
+}
+
+} // namespace icfp2012
@@ -0,0 +1,48 @@
+/*******************************************************************************
+ * icfp/2012/source/beam_search_max_score.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_BEAM_SEARCH_MAX_SCORE_HPP
+#define ICFP_2012_SOURCE_BEAM_SEARCH_MAX_SCORE_HPP
+
+#include <cstddef>
+
+#include <deque>
+#include <limits>
+
+#include <boost/function.hpp>
+
+#include "anytime_t.hpp"
+#include "delta_t.hpp"
+
+namespace icfp2012
+{
+
+typedef boost::function< int ( delta_t const & ) > beam_evaluate_t;
+
+// The default evaluation: the score.
+int beam_evaluate_score(delta_t const & state);
+
+// A beam search for the route with the highest score.  Each turn, only the
+// beam_width successors of the previous turn's states which evaluate highest
+// are kept, less duplicates and, if max_per_robot_index is given, all but the
+// best max_per_robot_index states with the robot in any one cell.  Memory is
+// O(beam_width) states plus O(beam_width) bytes per turn, and time is linear
+// in the number of turns.  The search ends once no states are left, after the
+// number of turns a map of its size allows, or once anytime expires.
+void beam_search_max_score(
+    delta_t const & start,
+    std::deque< char >& path,
+    std::size_t const beam_width,
+    std::size_t const max_per_robot_index =
+        std::numeric_limits< std::size_t >::max(),
+    beam_evaluate_t const & evaluate = &beam_evaluate_score,
+    anytime_t* const anytime = 0);
+
+} // namespace icfp2012
+
+#endif // #define ICFP_2012_SOURCE_BEAM_SEARCH_MAX_SCORE_HPP
@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * icfp/2012/source/best_first_max_score.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <deque>
+#include <queue>
+#include <vector>
+
+#include "anytime_t.hpp"
+#include "arena_t.hpp"
+#include "best_first_max_score.hpp"
+#include "bfs.hpp"
+#include "dead_state_analyzer_t.hpp"
+#include "delta_t.hpp"
+#include "index_t.hpp"
+#include "state_t.hpp"
+#include "transposition_table_t.hpp"
+#include "visited_state_t.hpp"
+
+namespace icfp2012
+{
+
+namespace
+{
+
+typedef visited_state_t<> visited_state_type;
+
+// Unlike in bfs, states are not visited in order of n_turns, so any state in
+// visited_bucket may be dominated by next, and only those are dropped from
+// it.
+template< class VisitedBucket >
+void deactivate_dominated(VisitedBucket& visited_bucket, delta_t const & next)
+{
+    for(std::size_t k = visited_bucket.size(); k != 0;) {
+        typename VisitedBucket::value_type const visited = visited_bucket[--k];
+        if(!next.partial_equal(visited->state)
+        || !next.partial_less(visited->state)
+        || visited->state.partial_less(next))
+            continue;
+        visited->active = false;
+        visited_bucket.erase(k);
+    }
+}
+
+void path_to(visited_state_type const & visited, std::deque< char >& path)
+{
+    visited_state_type const * p = &visited;
+    while(p->parent) {
+        assert(p->move);
+        path.push_front(p->move);
+        p = p->parent;
+    }
+}
+
+struct entry_t
+{
+    int bound;
+    int score;
+    std::size_t order;
+    visited_state_type const * visited;
+
+    entry_t(
+        int const bound_,
+        std::size_t const order_,
+        visited_state_type const * const visited_)
+        : bound(bound_),
+          score(visited_->state.score()),
+          order(order_),
+          visited(visited_)
+    { }
+
+    // Highest bound first, then highest score, then first in.
+    bool operator<(entry_t const & other) const
+    {
+        if(bound != other.bound)
+            return bound < other.bound;
+        if(score != other.score)
+            return score < other.score;
+        return order > other.order;
+    }
+};
+
+} // namespace
+
+void best_first_max_score(
+    delta_t const & start,
+    std::deque< char >& path,
+    std::size_t const max_visited_states /*=
+        std::numeric_limits< std::size_t >::max()*/,
+    anytime_t* const anytime /*= 0*/)
+{
+    typedef std::deque<
+        visited_state_type,
+        arena_allocator_t< visited_state_type >
+    > visited_store_type;
+    typedef transposition_table_t< visited_state_type* > visited_states_type;
+    typedef visited_states_type::bucket_t visited_bucket_type;
+
+    dead_state_analyzer_t const analyzer(start.apply());
+
+    arena_t arena;
+    arena_allocator_t< visited_state_type > const allocator(arena);
+    visited_store_type visited_store(allocator);
+    visited_states_type visited_states(arena, bfs_default_max_table_bytes);
+    std::priority_queue< entry_t > q;
+    visited_store.push_back(visited_state_type(start));
+    visited_store.back().state.cell_map.set_arena(&arena);
+    visited_states[start.partial_hash()].push_back(&visited_store.back());
+    visited_state_type const * best = &visited_store.back();
+    int best_score = best->state.score();
+    std::size_t n_visited_states = 1;
+    q.push(entry_t(analyzer.max_score(start), 0, best));
+
+    std::size_t n_expanded_states = 0;
+    while(!q.empty() && n_visited_states < max_visited_states) {
+        // Every state left has a bound no higher than the top's.
+        entry_t const top = q.top();
+        if(top.bound <= best_score)
+            break;
+        q.pop();
+        visited_state_type const * const current = top.visited;
+        if(!current->active)
+            continue;
+        if(anytime && ++n_expanded_states % 256 == 0 && anytime->is_expired())
+            break;
+
+        for(std::size_t i = 0; i != bfs_detail::n_moves; ++i) {
+            char const move = bfs_detail::moves[i];
+            if(!current->state.move_is_valid(move))
+                continue;
+            delta_t const next = current->state.move_robot_update(move);
+            if(next.robot_is_destroyed)
+                continue;
+            visited_bucket_type& visited_bucket =
+                visited_states[next.partial_hash()];
+            if(bfs_detail::is_dominated(visited_bucket, next))
+                continue;
+            deactivate_dominated(visited_bucket, next);
+            visited_store.push_back(visited_state_type(next, current, move));
+            visited_bucket.push_back(&visited_store.back());
+            ++n_visited_states;
+            visited_state_type const & visited = visited_store.back();
+            int const score = visited.state.score();
+            if(score > best_score) {
+                best = &visited;
+                best_score = score;
+                if(anytime) {
+                    std::deque< char > path1;
+                    path_to(visited, path1);
+                    anytime->offer(path1, score);
+                }
+            }
+            if(visited.state.robot_index == visited.state.base.lift_index)
+                continue;
+            int const bound = analyzer.max_score(visited.state);
+            if(bound > best_score)
+                q.push(entry_t(bound, n_visited_states, &visited));
+        }
+    }
+
+    path_to(*best, path);
+}
+
+} // namespace icfp2012
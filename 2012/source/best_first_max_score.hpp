@@ -0,0 +1,38 @@
+/*******************************************************************************
+ * icfp/2012/source/best_first_max_score.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_BEST_FIRST_MAX_SCORE_HPP
+#define ICFP_2012_SOURCE_BEST_FIRST_MAX_SCORE_HPP
+
+#include <cstddef>
+
+#include <deque>
+#include <limits>
+
+#include "anytime_t.hpp"
+#include "delta_t.hpp"
+
+namespace icfp2012
+{
+
+// An A* search for the route with the highest score.  States are expanded in
+// order of an upper bound on the score of any of their continuations, and
+// states whose bound cannot beat the best score found so far are dropped, so
+// the search ends with an optimal route once no state can.  Otherwise it ends
+// after max_visited_states states or once anytime expires, with the best
+// route found by then.
+void best_first_max_score(
+    delta_t const & start,
+    std::deque< char >& path,
+    std::size_t const max_visited_states =
+        std::numeric_limits< std::size_t >::max(),
+    anytime_t* const anytime = 0);
+
+} // namespace icfp2012
+
+#endif // #define ICFP_2012_SOURCE_BEST_FIRST_MAX_SCORE_HPP
@@ -11,84 +11,344 @@
 
 #include <cstddef>
 
+#include <algorithm>
 #include <deque>
-#include <list>
+#include <vector>
 
-#include <boost/unordered_map.hpp>
+#include <boost/optional.hpp>
+#include <boost/scoped_array.hpp>
 
+#include "arena_t.hpp"
 #include "delta_t.hpp"
+#include "thread_pool_t.hpp"
+#include "transposition_table_t.hpp"
 #include "visitor_result_e.hpp"
 #include "visited_state_t.hpp"
+#include "world_timeline_t.hpp"
 
 namespace icfp2012
 {
 
+std::size_t const bfs_default_max_table_bytes = 256 << 20;
+
+namespace bfs_detail
+{
+
+char const moves[] = { 'L', 'R', 'U', 'D', 'S', 'W' };
+std::size_t const n_moves = sizeof( moves );
+
+template< class VisitedBucket >
+inline bool
+is_dominated(VisitedBucket const & visited_bucket, delta_t const & next)
+{
+    for(std::size_t k = 0; k != visited_bucket.size(); ++k) {
+        delta_t const & visited = visited_bucket[k]->state;
+        if(visited.partial_equal(next)
+        && visited.partial_less(next))
+            return true;
+    }
+    return false;
+}
+
+// Whether next is no worse than visited in every respect but n_turns.
+inline bool
+counters_less(delta_t const & next, delta_t const & visited)
+{
+    return next.n_lambdas_remaining <= visited.n_lambdas_remaining
+        && !next.robot_is_destroyed
+        && next.n_turns_underwater <= visited.n_turns_underwater
+        && next.n_razors >= visited.n_razors;
+}
+
+// States are visited in order of n_turns, so once next's counters are no
+// worse than those of a visited state, next dominates every later state the
+// visited state does.  Such states are dropped from visited_bucket, which thus
+// holds only the Pareto front of the counters of each configuration (a handful
+// of states at most, however often the configuration is revisited), and those
+// as deep as next are deactivated.
+template< class VisitedBucket >
+inline void
+deactivate_dominated(VisitedBucket& visited_bucket, delta_t const & next)
+{
+    // Erasing moves the last state into position k, which is already done.
+    for(std::size_t k = visited_bucket.size(); k != 0;) {
+        typename VisitedBucket::value_type const visited = visited_bucket[--k];
+        if(!next.partial_equal(visited->state)
+        || !counters_less(next, visited->state))
+            continue;
+        if(visited->state.n_turns >= next.n_turns
+        && !visited->state.partial_less(next))
+            visited->active = false;
+        visited_bucket.erase(k);
+    }
+}
+
+} // namespace bfs_detail
+
+// The visited states, the queue, and the overlays of all states created during
+// the search are allocated from arena, so the states passed to visitor must
+// not outlive it.  The table indexing the visited states uses at most
+// max_table_bytes, beyond which it forgets states (see transposition_table_t).
+// Successors are computed from timeline, if given (see
+// delta_t::move_robot_update), and simplified if simplify, in which case start
+// (and the frames of timeline) must be simplified too.
 template< class Data, class Visitor >
-void bfs(delta_t const & start, Visitor visitor)
+void bfs(
+    delta_t const & start,
+    Visitor visitor,
+    arena_t& arena,
+    std::size_t const max_table_bytes = bfs_default_max_table_bytes,
+    world_timeline_t const * const timeline = 0,
+    bool const simplify = false)
 {
     typedef visited_state_t< Data > visited_state_type;
-    typedef std::list< visited_state_type > visited_sublist_type;
-    typedef boost::unordered_map<
-        std::size_t, visited_sublist_type
-    > visited_states_type;
-
-    visited_states_type visited_states;
-    std::deque< visited_state_type const * > q;
-    visited_states_type::iterator iter = visited_states.emplace(
-        start.hash_value(), visited_sublist_type()).first;
-    iter->second.push_back(visited_state_type(start));
-    visitor(iter->second.back());
-    q.push_back(&iter->second.back());
+    typedef std::deque<
+        visited_state_type,
+        arena_allocator_t< visited_state_type >
+    > visited_store_type;
+    // Keyed by delta_t::partial_hash, so that states which may dominate one
+    // another share a bucket.
+    typedef transposition_table_t< visited_state_type* > visited_states_type;
+    typedef typename visited_states_type::bucket_t visited_bucket_type;
+    typedef std::deque<
+        visited_state_type const *,
+        arena_allocator_t< visited_state_type const * >
+    > queue_type;
 
+    arena_allocator_t< visited_state_type > const allocator(arena);
+    // Elements of a deque do not move as it grows at either end.
+    visited_store_type visited_store(allocator);
+    visited_states_type visited_states(arena, max_table_bytes);
+    queue_type q(allocator);
+    visited_store.push_back(visited_state_type(start));
+    visited_store.back().state.cell_map.set_arena(&arena);
+    visited_states[start.partial_hash()].push_back(&visited_store.back());
+    visitor(visited_store.back());
+    q.push_back(&visited_store.back());
+
+    boost::optional< delta_t > successors[bfs_detail::n_moves];
     while(!q.empty()) {
         visited_state_type const * current = q.front();
         q.pop_front();
         if(!current->active)
             continue;
 
-        static char const moves[] = { 'L', 'R', 'U', 'D', 'S', 'W' };
-        for(std::size_t i = 0; i != sizeof( moves ); ++i) {{
-            char const move = moves[i];
-            if(!current->state.move_is_valid(move))
+        current->state.move_robot_update(
+            bfs_detail::moves, bfs_detail::n_moves, successors,
+            current->state.cell_map.get_arena(), timeline, simplify);
+        for(std::size_t i = 0; i != bfs_detail::n_moves; ++i) {
+            char const move = bfs_detail::moves[i];
+            if(!successors[i])
                 continue;
-            delta_t const next = current->state.move_robot_update(move);
+            delta_t const & next = *successors[i];
             if(next.robot_is_destroyed)
                 continue;
-            iter = visited_states.emplace(
-                next.hash_value(), visited_sublist_type()).first;
-            visited_sublist_type& visited_sublist = iter->second;
-            visited_sublist_type::iterator jter = visited_sublist.begin();
-            for(; jter != visited_sublist.end(); ++jter) {
-                delta_t const & visited = jter->state;
-                if(visited.partial_equal(next)
-                && visited.partial_less(next))
-                    goto FOR_I_CONTINUE;
-            }
-            while(jter != visited_sublist.begin()) {
-                delta_t const & visited = (--jter)->state;
-                if(visited.n_turns < next.n_turns)
-                    break;
-                if(next.partial_equal(visited)
-                && next.partial_less(visited)
-                && !visited.partial_less(next))
-                    jter->active = false;
-            }
-            visited_sublist.push_back(visited_state_type(next, current, move));
-            switch(visitor(visited_sublist.back())) {
+            visited_bucket_type& visited_bucket =
+                visited_states[next.partial_hash()];
+            if(bfs_detail::is_dominated(visited_bucket, next))
+                continue;
+            bfs_detail::deactivate_dominated(visited_bucket, next);
+            visited_store.push_back(visited_state_type(next, current, move));
+            visited_bucket.push_back(&visited_store.back());
+            switch(visitor(visited_store.back())) {
             case visitor_result_e_continue:
-                q.push_back(&visited_sublist.back());
+                q.push_back(&visited_store.back());
+                break;
+            case visitor_result_e_prune:
                 break;
             case visitor_result_e_skip:
-                visited_sublist.pop_back();
+                visited_bucket.pop_back();
+                visited_store.pop_back();
                 break;
             case visitor_result_e_return:
                 return;
             }
-        }FOR_I_CONTINUE:;}
+        }
+    }
+}
+
+namespace bfs_detail
+{
+
+// Computes the successors of layer[k] (simplified, if simplify), less those
+// dominated by a visited state from an earlier layer, into
+// successors[n_moves * k + i] for moves[i].  The overlays of the successors
+// are allocated from arenas[thread_index].
+template< class VisitedState, class VisitedStates >
+struct expand_t
+{
+    VisitedState const * const * layer;
+    boost::optional< delta_t >* successors;
+    VisitedStates const * visited_states;
+    arena_t* const * arenas;
+    world_timeline_t const * timeline;
+    bool simplify;
 
+    expand_t(
+        VisitedState const * const * const layer_,
+        boost::optional< delta_t >* const successors_,
+        VisitedStates const * const visited_states_,
+        arena_t* const * const arenas_,
+        world_timeline_t const * const timeline_,
+        bool const simplify_)
+        : layer(layer_),
+          successors(successors_),
+          visited_states(visited_states_),
+          arenas(arenas_),
+          timeline(timeline_),
+          simplify(simplify_)
+    { }
+
+    typedef void result_type;
+
+    void operator()(std::size_t const k, std::size_t const thread_index) const
+    {
+        VisitedState const & current = *layer[k];
+        if(!current.active)
+            return;
+        boost::optional< delta_t >* const successors_ = successors + n_moves * k;
+        current.state.move_robot_update(
+            moves, n_moves, successors_, arenas[thread_index], timeline,
+            simplify);
+        for(std::size_t i = 0; i != n_moves; ++i) {
+            if(!successors_[i])
+                continue;
+            delta_t const & next = *successors_[i];
+            if(!next.robot_is_destroyed) {
+                typename VisitedStates::bucket_t const * const visited_bucket =
+                    visited_states->find(next.partial_hash());
+                if(!visited_bucket || !is_dominated(*visited_bucket, next))
+                    continue;
+            }
+            successors_[i] = boost::none;
+        }
+    }
+};
+
+} // namespace bfs_detail
+
+// A level-synchronous variant of bfs, which expands each layer of the search a
+// batch at a time, computing the successors in a batch in parallel on pool.
+// Successors are then checked against the visited states and passed to
+// visitor on the calling thread in the same order as bfs, so the visitor sees
+// the same sequence of states for any number of threads.  (The two may differ
+// only once the visited table is full and forgetting states.)  A pool of one
+// thread just runs bfs, which avoids the overhead of batching.
+template< class Data, class Visitor >
+void parallel_bfs(
+    delta_t const & start,
+    Visitor visitor,
+    thread_pool_t& pool,
+    arena_t& arena,
+    std::size_t const max_table_bytes = bfs_default_max_table_bytes,
+    world_timeline_t const * const timeline = 0,
+    bool const simplify = false)
+{
+    typedef visited_state_t< Data > visited_state_type;
+    typedef std::deque<
+        visited_state_type,
+        arena_allocator_t< visited_state_type >
+    > visited_store_type;
+    typedef transposition_table_t< visited_state_type* > visited_states_type;
+    typedef typename visited_states_type::bucket_t visited_bucket_type;
+    typedef std::vector< visited_state_type const * > layer_type;
+    typedef bfs_detail::expand_t<
+        visited_state_type, visited_states_type
+    > expand_type;
+
+    if(pool.size() == 1) {
+        bfs< Data >(
+            start, visitor, arena, max_table_bytes, timeline, simplify);
+        return;
+    }
+
+    std::size_t const batch_size = 4096;
+
+    // Thread 0 is the calling thread, which allocates from arena.
+    boost::scoped_array< arena_t > const thread_arenas(
+        new arena_t[pool.size() - 1]);
+    std::vector< arena_t* > arenas(1, &arena);
+    for(std::size_t t = 0; t != pool.size() - 1; ++t)
+        arenas.push_back(&thread_arenas[t]);
+
+    arena_allocator_t< visited_state_type > const allocator(arena);
+    visited_store_type visited_store(allocator);
+    visited_states_type visited_states(arena, max_table_bytes);
+    std::vector< boost::optional< delta_t > > successors;
+    layer_type layer;
+    layer_type next_layer;
+    visited_store.push_back(visited_state_type(start));
+    visited_store.back().state.cell_map.set_arena(&arena);
+    visited_states[start.partial_hash()].push_back(&visited_store.back());
+    visitor(visited_store.back());
+    layer.push_back(&visited_store.back());
+
+    while(!layer.empty()) {
+        for(std::size_t first = 0; first < layer.size(); first += batch_size) {
+            std::size_t const n =
+                std::min(batch_size, layer.size() - first);
+            successors.resize(bfs_detail::n_moves * n);
+            pool.for_each_index(
+                n,
+                expand_type(
+                    &layer[first], &successors[0], &visited_states, &arenas[0],
+                    timeline, simplify),
+                16);
+            for(std::size_t k = 0; k != successors.size(); ++k) {
+                if(!successors[k])
+                    continue;
+                delta_t const & next = *successors[k];
+                visited_state_type const * const current =
+                    layer[first + k / bfs_detail::n_moves];
+                char const move = bfs_detail::moves[k % bfs_detail::n_moves];
+                visited_bucket_type& visited_bucket =
+                    visited_states[next.partial_hash()];
+                if(bfs_detail::is_dominated(visited_bucket, next))
+                    continue;
+                bfs_detail::deactivate_dominated(visited_bucket, next);
+                visited_store.push_back(
+                    visited_state_type(next, current, move));
+                visited_bucket.push_back(&visited_store.back());
+                switch(visitor(visited_store.back())) {
+                case visitor_result_e_continue:
+                    next_layer.push_back(&visited_store.back());
+                    break;
+                case visitor_result_e_prune:
+                    break;
+                case visitor_result_e_skip:
+                    visited_bucket.pop_back();
+                    visited_store.pop_back();
+                    break;
+                case visitor_result_e_return:
+                    return;
+                }
+            }
+            successors.clear();
+        }
+        layer.swap(next_layer);
+        next_layer.clear();
     }
 }
 
+template< class Visitor >
+inline void parallel_bfs(
+    delta_t const & start,
+    Visitor const & visitor,
+    thread_pool_t& pool,
+    arena_t& arena)
+{ parallel_bfs< void >(start, visitor, pool, arena); }
+
+template< class Data, class Visitor >
+inline void bfs(delta_t const & start, Visitor visitor)
+{
+    arena_t arena;
+    bfs< Data >(start, visitor, arena);
+}
+
+template< class Visitor >
+inline void bfs(delta_t const & start, Visitor const & visitor, arena_t& arena)
+{ bfs< void >(start, visitor, arena); }
+
 template< class Visitor >
 inline void bfs(delta_t const & start, Visitor const & visitor)
 { bfs< void >(start, visitor); }
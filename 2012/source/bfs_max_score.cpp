@@ -11,11 +11,17 @@
 
 #include <deque>
 
+#include "anytime_t.hpp"
+#include "arena_t.hpp"
 #include "bfs.hpp"
 #include "bfs_max_score.hpp"
+#include "dead_state_analyzer_t.hpp"
 #include "delta_t.hpp"
+#include "state_t.hpp"
+#include "thread_pool_t.hpp"
 #include "visited_state_t.hpp"
 #include "visitor_result_e.hpp"
+#include "world_timeline_t.hpp"
 
 namespace icfp2012
 {
@@ -28,16 +34,22 @@ struct visitor_t
     typedef visited_state_t<> visited_state_type;
 
     std::deque< char >& path;
+    dead_state_analyzer_t const & analyzer;
     std::size_t n_visited_states;
     std::size_t const max_visited_states;
+    anytime_t* const anytime;
     visited_state_type const * visited_with_max_score;
 
     visitor_t(
         std::deque< char >& path_,
-        std::size_t const max_visited_states_)
+        dead_state_analyzer_t const & analyzer_,
+        std::size_t const max_visited_states_,
+        anytime_t* const anytime_)
         : path(path_),
+          analyzer(analyzer_),
           n_visited_states(0),
           max_visited_states(max_visited_states_),
+          anytime(anytime_),
           visited_with_max_score(0)
     { }
 
@@ -45,19 +57,36 @@ struct visitor_t
 
     result_type operator()(visited_state_type& visited)
     {
+        // path is kept to the best state so far, since the search may run out
+        // of states (every one pruned) before the visitor returns.
         if(!visited_with_max_score
-        || visited.state.score() > visited_with_max_score->state.score())
+        || visited.state.score() > visited_with_max_score->state.score()) {
             visited_with_max_score = &visited;
+            path_to(visited, path);
+            if(anytime)
+                anytime->offer(path, visited.state.score());
+        }
         if(++n_visited_states < max_visited_states
-        && visited.state.robot_index != visited.state.base.lift_index)
-            return visitor_result_e_continue;
-        visited_state_type const * p = visited_with_max_score;
+        && visited.state.robot_index != visited.state.base.lift_index
+        && !(anytime && n_visited_states % 1024 == 0 && anytime->is_expired()))
+            return analyzer.is_dead(
+                visited.state, visited_with_max_score->state.score()) ?
+                visitor_result_e_prune : visitor_result_e_continue;
+        return visitor_result_e_return;
+    }
+
+private:
+    static void path_to(
+        visited_state_type const & visited,
+        std::deque< char >& path)
+    {
+        path.clear();
+        visited_state_type const * p = &visited;
         while(p->parent) {
             assert(p->move);
             path.push_front(p->move);
             p = p->parent;
         }
-        return visitor_result_e_return;
     }
 };
 
@@ -67,7 +96,26 @@ void bfs_max_score(
     delta_t const & start,
     std::deque< char >& path,
     std::size_t const max_visited_states /*=
-        std::numeric_limits< std::size_t >::max()*/)
-{ bfs(start, visitor_t(path, max_visited_states)); }
+        std::numeric_limits< std::size_t >::max()*/,
+    std::size_t const n_threads /*= 1*/,
+    arena_t::stats_t* const arena_stats /*= 0*/,
+    anytime_t* const anytime /*= 0*/)
+{
+    dead_state_analyzer_t const analyzer(start.apply());
+    // Simplified states have fewer active cells and merge more often in the
+    // visited table.
+    state_t simplified_base = start.apply();
+    simplified_base.simplify_ip();
+    delta_t const simplified_start(simplified_base);
+    world_timeline_t const timeline(simplified_start, true);
+    arena_t arena;
+    thread_pool_t pool(n_threads);
+    parallel_bfs< void >(
+        simplified_start,
+        visitor_t(path, analyzer, max_visited_states, anytime),
+        pool, arena, bfs_default_max_table_bytes, &timeline, true);
+    if(arena_stats)
+        *arena_stats = arena.stats();
+}
 
 } // namespace icfp2012
@@ -14,6 +14,8 @@
 #include <deque>
 #include <limits>
 
+#include "anytime_t.hpp"
+#include "arena_t.hpp"
 #include "delta_t.hpp"
 
 namespace icfp2012
@@ -23,7 +25,10 @@ void bfs_max_score(
     delta_t const & start,
     std::deque< char >& path,
     std::size_t const max_visited_states =
-        std::numeric_limits< std::size_t >::max());
+        std::numeric_limits< std::size_t >::max(),
+    std::size_t const n_threads = 1,
+    arena_t::stats_t* const arena_stats = 0,
+    anytime_t* const anytime = 0);
 
 } // namespace icfp2012
 
@@ -0,0 +1,334 @@
+/*******************************************************************************
+ * icfp/2012/source/bitboard_t.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <iostream>
+
+#include <boost/foreach.hpp>
+
+#include "bitboard_t.hpp"
+#include "index_t.hpp"
+#include "state_t.hpp"
+
+namespace icfp2012
+{
+
+namespace
+{
+
+typedef bitboard_t::word_type word_type;
+
+// Bit j of the result is bit j+1 of the row, i.e., the right neighbor.
+inline word_type
+from_right(word_type const * const row, std::size_t const w, std::size_t const n_words)
+{ return row[w] >> 1 | (w + 1 != n_words ? row[w+1] << 63 : 0); }
+
+// Bit j of the result is bit j-1 of the row, i.e., the left neighbor.
+inline word_type
+from_left(word_type const * const row, std::size_t const w)
+{ return row[w] << 1 | (w != 0 ? row[w-1] >> 63 : 0); }
+
+} // namespace
+
+/*******************************************************************************
+ * bitboard_t::bitboard_t(state_t const & state)
+ ******************************************************************************/
+
+bitboard_t::
+bitboard_t(state_t const & state)
+    : n_rows(state.n_rows),
+      n_cols(state.n_cols),
+      n_words((state.n_cols + 63) / 64),
+      glyphs(state.cells),
+      robot_index(state.robot_index),
+      lift_index(state.lift_index),
+      n_turns(state.n_turns),
+      n_lambdas_remaining(state.n_lambdas_remaining),
+      n_lambdas_collected(state.n_lambdas_collected),
+      robot_is_destroyed(state.robot_is_destroyed),
+      water_level(state.water_level),
+      flooding_rate(state.flooding_rate),
+      waterproof(state.waterproof),
+      n_turns_underwater(state.n_turns_underwater),
+      beard_growth_rate(state.beard_growth_rate),
+      n_razors(state.n_razors),
+      trampoline_map(state.trampoline_map),
+      target_map(state.target_map)
+{
+    for(std::size_t plane = 0; plane != plane_e_count; ++plane)
+        planes[plane].assign(n_rows * n_words, 0);
+    for(std::size_t i = 0; i != n_rows; ++i)
+        for(std::size_t j = 0; j != n_cols; ++j)
+            assign(index_t(i,j), state[i][j]);
+}
+
+/*******************************************************************************
+ * bitboard_t::assign(index_t const index, char const cell) -> void
+ ******************************************************************************/
+
+void
+bitboard_t::
+assign(index_t const index, char const cell)
+{
+    assert(index.i() < n_rows && index.j() < n_cols);
+    std::size_t const k = index.i() * n_words + index.j() / 64;
+    word_type const bit = static_cast< word_type >(1) << (index.j() % 64);
+    bool plane_found = false;
+    for(std::size_t plane = 0; plane != plane_e_count; ++plane) {
+        if(as_c(static_cast< plane_e >(plane)) == cell) {
+            planes[plane][k] |= bit;
+            plane_found = true;
+        }
+        else
+            planes[plane][k] &= ~bit;
+    }
+    if(!plane_found)
+        glyphs[index.i() * n_cols + index.j()] = cell;
+}
+
+/*******************************************************************************
+ * bitboard_t::move_robot_update_ip(char const move) -> void
+ ******************************************************************************/
+
+void
+bitboard_t::
+move_robot_update_ip(char const move)
+{
+    assert(!robot_is_destroyed);
+    assert(move != 'A');
+
+    ++n_turns;
+
+    bitboard_t& this_ = *this;
+
+    // Move robot.
+    switch(move) {
+    case 'W':
+        break;
+    case 'S':
+        if(n_razors == 0)
+            break;
+        --n_razors;
+        for(std::size_t i = robot_index.i()-1; i != robot_index.i()+2; ++i)
+            for(std::size_t j = robot_index.j()-1; j != robot_index.j()+2; ++j)
+                if(test(plane_e_beard, index_t(i,j)))
+                    assign(index_t(i,j), ' ');
+        break;
+    default: {
+        index_t dest_index = robot_index + move;
+        char const dest_cell = this_[dest_index];
+        switch(dest_cell) {
+        case '*':
+        case '@': {
+            index_t const other_index = dest_index + move;
+            if(!(move == 'L' || move == 'R') || this_[other_index] != ' ')
+                break;
+            assign(other_index, dest_cell);
+            goto CASE_COMMON;
+        }
+        case '\\':
+            ++n_lambdas_collected;
+            --n_lambdas_remaining;
+            goto CASE_COMMON;
+        case '!':
+            ++n_razors;
+            goto CASE_COMMON;
+        case 'O':
+        case '.':
+        case ' ':
+            goto CASE_COMMON;
+        default:
+            if(!('A' <= dest_cell && dest_cell <= 'I'))
+                break;
+            dest_index = trampoline_map[dest_cell];
+            BOOST_FOREACH(
+                index_t const trampoline_index,
+                target_map[this_[dest_index]] ) {
+                char const trampoline_cell = this_[trampoline_index];
+                if('A' <= trampoline_cell && trampoline_cell <= 'I')
+                    assign(trampoline_index, ' ');
+            }
+        CASE_COMMON:
+            assign(robot_index, ' ');
+            assign(dest_index, 'R');
+            robot_index = dest_index;
+        }
+    }}
+
+    if(flooding_rate != 0 && (n_turns % flooding_rate) == 0 && water_level != 0)
+        --water_level;
+
+    bool const grow_beards = beard_growth_rate != 0
+                          && (n_turns % beard_growth_rate == 0);
+
+    // Update cells.  The robot is only destroyed by a rock (or a lambda rock,
+    // which necessarily breaks) landing in the empty cell above it.
+    index_t const above_robot_index = robot_index + 'U';
+    bool const above_robot_was_empty = test(plane_e_empty, above_robot_index);
+    update_ip(grow_beards);
+    robot_is_destroyed = above_robot_was_empty
+                      && (test(plane_e_rock, above_robot_index)
+                       || test(plane_e_lambda, above_robot_index));
+
+    // Check special conditions.
+    if(robot_index == lift_index)
+        robot_is_destroyed = false;
+    else {
+        if(n_lambdas_remaining == 0)
+            assign(lift_index, 'O');
+        if(robot_index.i() < water_level)
+            n_turns_underwater = 0;
+        else if(++n_turns_underwater > waterproof)
+            robot_is_destroyed = true;
+    }
+}
+
+/*******************************************************************************
+ * bitboard_t::update_ip(bool const grow_beards) -> void
+ ******************************************************************************/
+
+void
+bitboard_t::
+update_ip(bool const grow_beards)
+{
+    // As in state_t::move_robot_update_ip, all updates are determined from the
+    // cells at the start of the update, and applied in update_compare_t order
+    // (bottom-to-top, then left-to-right), a later update of a cell
+    // overriding an earlier one.  The only cells updated more than once are
+    // empty cells which receive two rocks, one sliding right and one sliding
+    // left, where the rock sliding left wins; and empty cells which receive a
+    // rock and a beard, where the beard wins only if it is up and to the
+    // right.
+
+    std::vector< word_type > const & empty = planes[plane_e_empty];
+    std::vector< word_type > const & rock = planes[plane_e_rock];
+    std::vector< word_type > const & lambda_rock = planes[plane_e_lambda_rock];
+    std::vector< word_type > const & fixed_rock = planes[plane_e_fixed_rock];
+    std::vector< word_type > const & lambda = planes[plane_e_lambda];
+    std::vector< word_type > const & beard = planes[plane_e_beard];
+
+    std::size_t const n = n_rows * n_words;
+
+    // Determine which rocks leave their cell.
+    fall.assign(n, 0);
+    slide_right.assign(n, 0);
+    slide_left.assign(n, 0);
+    word_type any_moved = 0;
+    for(std::size_t i = 1; i != n_rows - 1; ++i) {
+        std::size_t const k = i * n_words;
+        std::size_t const kD = k + n_words;
+        for(std::size_t w = 0; w != n_words; ++w) {
+            word_type const rocks = rock[k+w] | lambda_rock[k+w];
+            if(rocks == 0)
+                continue;
+            word_type const rocksD =
+                rock[kD+w] | lambda_rock[kD+w] | fixed_rock[kD+w];
+            word_type const emptyR =
+                from_right(&empty[k], w, n_words)
+              & from_right(&empty[kD], w, n_words);
+            word_type const emptyL =
+                from_left(&empty[k], w)
+              & from_left(&empty[kD], w);
+            fall[k+w] = rocks & empty[kD+w];
+            slide_right[k+w] = rocks & (rocksD | lambda[kD+w]) & emptyR;
+            slide_left[k+w] = rocks & rocksD & ~slide_right[k+w] & emptyL;
+            any_moved |= fall[k+w] | slide_right[k+w] | slide_left[k+w];
+        }
+    }
+
+    if(any_moved == 0 && !grow_beards)
+        return;
+
+    // Determine the new cells.
+    std::vector< word_type >& next_empty = next_planes[plane_e_empty];
+    std::vector< word_type >& next_rock = next_planes[plane_e_rock];
+    std::vector< word_type >& next_lambda_rock = next_planes[plane_e_lambda_rock];
+    std::vector< word_type >& next_lambda = next_planes[plane_e_lambda];
+    std::vector< word_type >& next_beard = next_planes[plane_e_beard];
+    next_empty.assign(n, 0);
+    next_rock.assign(n, 0);
+    next_lambda_rock.assign(n, 0);
+    next_lambda = lambda;
+    next_beard = beard;
+    for(std::size_t i = 1; i != n_rows - 1; ++i) {
+        std::size_t const k = i * n_words;
+        std::size_t const kU = k - n_words;
+        std::size_t const kD = k + n_words;
+        for(std::size_t w = 0; w != n_words; ++w) {
+            word_type const moved =
+                fall[k+w] | slide_right[k+w] | slide_left[k+w];
+
+            word_type const landed_right = from_left(&slide_right[kU], w);
+            word_type const landed_left = from_right(&slide_left[kU], w, n_words);
+            word_type const landed = fall[kU+w] | landed_right | landed_left;
+            word_type const landed_lambda_rock =
+                (landed_left & from_right(&lambda_rock[kU], w, n_words))
+              | (~landed_left
+               & ((landed_right & from_left(&lambda_rock[kU], w))
+                | (fall[kU+w] & lambda_rock[kU+w])));
+            word_type const broken = ~empty[kD+w];
+
+            word_type grown = 0;
+            word_type beard_wins = 0;
+            if(grow_beards) {
+                word_type beards = 0;
+                for(std::size_t kk = kU; kk != kD + n_words; kk += n_words)
+                    beards |= beard[kk+w]
+                            | from_left(&beard[kk], w)
+                            | from_right(&beard[kk], w, n_words);
+                beard_wins = empty[k+w] & from_right(&beard[kU], w, n_words);
+                grown = empty[k+w] & beards & (beard_wins | ~landed);
+            }
+            word_type const rock_landed = landed & ~beard_wins;
+
+            next_empty[k+w] = (empty[k+w] & ~rock_landed & ~grown) | moved;
+            next_rock[k+w] = (rock[k+w] & ~moved)
+                           | (rock_landed & ~landed_lambda_rock);
+            next_lambda_rock[k+w] = (lambda_rock[k+w] & ~moved)
+                                  | (rock_landed & landed_lambda_rock & ~broken);
+            next_lambda[k+w] |= rock_landed & landed_lambda_rock & broken;
+            next_beard[k+w] |= grown;
+        }
+    }
+
+    planes[plane_e_empty].swap(next_empty);
+    planes[plane_e_rock].swap(next_rock);
+    planes[plane_e_lambda_rock].swap(next_lambda_rock);
+    planes[plane_e_lambda].swap(next_lambda);
+    planes[plane_e_beard].swap(next_beard);
+}
+
+/*******************************************************************************
+ * operator<<(std::ostream& o, bitboard_t const & this_) -> std::ostream&
+ ******************************************************************************/
+
+std::ostream&
+operator<<(std::ostream& o, bitboard_t const & this_)
+{
+    o << "After " << this_.n_turns << " turns: " << std::endl;
+    o << "Turns underwater: " << this_.n_turns_underwater << std::endl;
+
+    std::size_t const water_level =
+        std::max< std::size_t >(this_.water_level, 1);
+    for(std::size_t i = 1; i != this_.n_rows - 1; ++i) {
+        if(i == water_level) {
+            for(std::size_t j = 1; j != this_.n_cols - 1; ++j)
+                o << '~';
+            o << std::endl;
+        }
+        for(std::size_t j = 1; j != this_.n_cols - 1; ++j)
+            o << this_[index_t(i,j)];
+        o << std::endl;
+    }
+    return o;
+}
+
+} // namespace icfp2012
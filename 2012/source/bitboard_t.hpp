@@ -0,0 +1,198 @@
+/*******************************************************************************
+ * icfp/2012/source/bitboard_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_BITBOARD_T_HPP
+#define ICFP_2012_SOURCE_BITBOARD_T_HPP
+
+#include <cassert>
+#include <cstddef>
+
+#include <deque>
+#include <iosfwd>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+
+#include "index_t.hpp"
+#include "move_is_valid.hpp"
+#include "state_t.hpp"
+
+namespace icfp2012
+{
+
+// An alternative world representation to state_t, storing one bit-plane per
+// cell class, with each row padded out to a whole number of 64-bit words.
+// The update phase of a turn (falling and sliding rocks, breaking lambda
+// rocks, and growing beards) is computed a word at a time over all cells
+// rather than cell-by-cell over the active cells.  Cells belonging to no
+// plane (the robot, the lift, trampolines, and targets) are kept as glyphs.
+struct bitboard_t
+{
+    typedef boost::uint64_t word_type;
+
+    enum plane_e
+    {
+        plane_e_empty,
+        plane_e_earth,
+        plane_e_rock,
+        plane_e_lambda_rock,
+        plane_e_fixed_rock,
+        plane_e_lambda,
+        plane_e_beard,
+        plane_e_razor,
+        plane_e_wall,
+        plane_e_count
+    };
+
+    std::size_t n_rows;
+    std::size_t n_cols;
+    std::size_t n_words;
+
+    std::vector< word_type > planes[plane_e_count];
+    std::vector< char > glyphs;
+
+    index_t robot_index;
+    index_t lift_index;
+
+    unsigned int n_turns;
+    unsigned int n_lambdas_remaining;
+    unsigned int n_lambdas_collected;
+    bool robot_is_destroyed;
+
+    unsigned int water_level;
+    unsigned int flooding_rate;
+    unsigned int waterproof;
+    unsigned int n_turns_underwater;
+
+    unsigned int beard_growth_rate;
+    unsigned int n_razors;
+
+    state_t::trampoline_map_t trampoline_map;
+    state_t::target_map_t target_map;
+
+    explicit bitboard_t(state_t const & state);
+
+    static char as_c(plane_e const plane);
+
+    bool test(plane_e const plane, index_t const index) const;
+
+private:
+    class bracket_proxy;
+public:
+    bracket_proxy operator[](index_t const index);
+    char operator[](index_t const index) const;
+
+    int score() const;
+
+    bool move_is_valid(char const move) const;
+
+    void move_robot_update_ip(char const move);
+    void move_robot_update_ip(std::deque< char > const & moves);
+
+private:
+    // Scratch planes for the rocks leaving each cell (by falling, sliding
+    // right, and sliding left, respectively) and for the planes being
+    // computed by an update, kept to avoid reallocating on every turn.
+    std::vector< word_type > fall;
+    std::vector< word_type > slide_right;
+    std::vector< word_type > slide_left;
+    std::vector< word_type > next_planes[plane_e_count];
+
+    void assign(index_t const index, char const cell);
+    void update_ip(bool const grow_beards);
+};
+
+std::ostream& operator<<(std::ostream& o, bitboard_t const & this_);
+
+/*******************************************************************************
+ ******************************************************************************/
+
+class bitboard_t::bracket_proxy
+{
+    bitboard_t& this_;
+    index_t const index;
+    explicit bracket_proxy(bitboard_t& _this_, index_t const index_)
+        : this_(_this_), index(index_)
+    { }
+    friend struct bitboard_t;
+public:
+
+    operator char() const
+    { return const_cast< bitboard_t const & >(this_)[index]; }
+
+    bracket_proxy const &
+    operator=(char const cell) const
+    {
+        this_.assign(index, cell);
+        return *this;
+    }
+};
+
+/*******************************************************************************
+ ******************************************************************************/
+
+inline char
+bitboard_t::
+as_c(plane_e const plane)
+{
+    static char const cells[] = { ' ', '.', '*', '@', '+', '\\', 'W', '!', '#' };
+    assert(plane < plane_e_count);
+    return cells[plane];
+}
+
+inline bool
+bitboard_t::
+test(plane_e const plane, index_t const index) const
+{
+    assert(index.i() < n_rows && index.j() < n_cols);
+    word_type const word = planes[plane][index.i() * n_words + index.j() / 64];
+    return (word >> (index.j() % 64) & 1) != 0;
+}
+
+inline bitboard_t::bracket_proxy
+bitboard_t::
+operator[](index_t const index)
+{ return bracket_proxy(*this, index); }
+
+inline char
+bitboard_t::
+operator[](index_t const index) const
+{
+    for(std::size_t plane = 0; plane != plane_e_count; ++plane)
+        if(test(static_cast< plane_e >(plane), index))
+            return as_c(static_cast< plane_e >(plane));
+    return glyphs[index.i() * n_cols + index.j()];
+}
+
+inline int
+bitboard_t::
+score() const
+{
+    unsigned int const points_per_lambda =
+        25 + (robot_index == lift_index ? 50 : !robot_is_destroyed ? 25 : 0);
+    return static_cast< int >(points_per_lambda * n_lambdas_collected)
+         - static_cast< int >(n_turns);
+}
+
+inline bool
+bitboard_t::
+move_is_valid(char const move) const
+{ return icfp2012::move_is_valid(*this, move); }
+
+inline void
+bitboard_t::
+move_robot_update_ip(std::deque< char > const & moves)
+{
+    BOOST_FOREACH( char const move, moves )
+        move_robot_update_ip(move);
+}
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_BITBOARD_T_HPP
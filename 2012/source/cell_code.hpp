@@ -0,0 +1,55 @@
+/*******************************************************************************
+ * icfp/2012/source/cell_code.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_CELL_CODE_HPP
+#define ICFP_2012_SOURCE_CELL_CODE_HPP
+
+#include <cassert>
+
+namespace icfp2012
+{
+
+// A 4-bit code for each cell other than a trampoline or target, so that two
+// cells pack into a byte; 0 codes no cell.  Trampolines and targets only ever
+// disappear, so a cell which differs from the base state of a game (see
+// delta_t) is never one of them, and their identities are left to the base.
+inline unsigned int
+encode_cell(char const cell)
+{
+    switch(cell) {
+    case ' ':  return 1;
+    case '.':  return 2;
+    case '#':  return 3;
+    case '*':  return 4;
+    case '@':  return 5;
+    case '+':  return 6;
+    case '\\': return 7;
+    case '!':  return 8;
+    case 'W':  return 9;
+    case 'R':  return 10;
+    case 'L':  return 11;
+    case 'O':  return 12;
+    default:
+        assert(false);
+        return 0;
+    }
+}
+
+inline char
+decode_cell(unsigned int const code)
+{
+    static char const cells[16] = {
+        0, ' ', '.', '#', '*', '@', '+', '\\', '!', 'W', 'R', 'L', 'O', 0, 0, 0
+    };
+    assert(code < 13);
+    return cells[code];
+}
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_CELL_CODE_HPP
@@ -40,8 +40,8 @@ cell_is_active(State const & state, index_t const index)
     case '@':
         return rock_is_active(state, index);
     case 'W':
-        for(std::size_t i = index.i-1; i != index.i+2; ++i)
-            for(std::size_t j = index.j-1; j != index.j+2; ++j)
+        for(std::size_t i = index.i()-1; i != index.i()+2; ++i)
+            for(std::size_t j = index.j()-1; j != index.j()+2; ++j)
                 if(state[index_t(i,j)] == ' ')
                     return true;
     default:;
@@ -0,0 +1,236 @@
+/*******************************************************************************
+ * icfp/2012/source/cell_map_t.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#include <new>
+
+#include <boost/functional/hash.hpp>
+
+#include "arena_t.hpp"
+#include "cell_map_t.hpp"
+
+namespace icfp2012
+{
+
+/*******************************************************************************
+ * cell_map_t::cell_map_t(std::size_t const n_cells)
+ ******************************************************************************/
+
+cell_map_t::
+cell_map_t(std::size_t const n_cells)
+    : depth(1),
+      n_elements(0),
+      root(0),
+      arena(0)
+{
+    while((static_cast< std::size_t >(1) << 4 * depth) < n_cells)
+        ++depth;
+}
+
+/*******************************************************************************
+ * cell_map_t::release(node_t const * const p) const -> void
+ ******************************************************************************/
+
+void
+cell_map_t::
+release(node_t const * const p) const
+{
+    using boost::interprocess::ipcdetail::atomic_dec32;
+    if(!p || atomic_dec32(&p->n_refs) != 1)
+        return;
+    if(!p->is_leaf) {
+        node_t const * const * const children = p->children();
+        for(unsigned int slot = popcount(p->mask); slot != 0;)
+            release(children[--slot]);
+    }
+    std::size_t const size = node_t::size(p->is_leaf, p->mask);
+    p->~node_t();
+    if(arena)
+        arena->deallocate(const_cast< node_t* >(p), size);
+    else
+        ::operator delete(const_cast< node_t* >(p));
+}
+
+/*******************************************************************************
+ * cell_map_t::allocate(bool const is_leaf, unsigned int const mask) const
+ *     -> node_t*
+ ******************************************************************************/
+
+cell_map_t::node_t*
+cell_map_t::
+allocate(bool const is_leaf, unsigned int const mask) const
+{
+    std::size_t const size = node_t::size(is_leaf, mask);
+    void* const p = arena ? arena->allocate(size) : ::operator new(size);
+    node_t* const q = new(p) node_t(is_leaf, mask);
+    if(is_leaf)
+        std::memset(q->codes(), 0, node_t::n_code_bytes(mask));
+    return q;
+}
+
+/*******************************************************************************
+ * cell_map_t::assign(std::size_t const offset, char const cell) -> void
+ ******************************************************************************/
+
+void
+cell_map_t::
+assign(std::size_t const offset, char const cell)
+{
+    char const old_cell = find(offset);
+    if(old_cell == cell)
+        return;
+    node_t const * const new_root = assign_(root, 0, true, offset, cell);
+    if(new_root != root) {
+        release(root);
+        root = new_root;
+    }
+    n_elements += (cell != 0) - (old_cell != 0);
+}
+
+/*******************************************************************************
+ * cell_map_t::assign_(
+ *     node_t const * const p,
+ *     std::size_t const level,
+ *     bool const is_unique,
+ *     std::size_t const offset,
+ *     char const cell)
+ *     -> node_t const *
+ *
+ * Returns the node replacing p (which is p itself if it was modified in place,
+ * and 0 if it became empty), holding a reference to it if it is not p.  p may
+ * only be modified in place if it and all its ancestors (is_unique) are
+ * referred to only once.  Assumes the cell at offset is not already cell.
+ ******************************************************************************/
+
+cell_map_t::node_t const *
+cell_map_t::
+assign_(
+    node_t const * const p,
+    std::size_t const level,
+    bool is_unique,
+    std::size_t const offset,
+    char const cell)
+{
+    is_unique = is_unique && p
+             && boost::interprocess::ipcdetail::atomic_read32(&p->n_refs) == 1;
+    bool const is_leaf = level + 1 == depth;
+    std::size_t const d = digit(offset, level);
+    unsigned int const bit = 1u << d;
+    unsigned int const old_mask = p ? p->mask : 0;
+
+    node_t const * child = 0;
+    if(!is_leaf) {
+        node_t const * const old_child =
+            old_mask & bit ? p->children()[p->slot(d)] : 0;
+        child = assign_(old_child, level + 1, is_unique, offset, cell);
+        if(child == old_child)
+            return p;
+    }
+    bool const present = is_leaf ? cell != 0 : child != 0;
+
+    // Modify p in place if no other map can see it and its shape is unchanged.
+    if(is_unique && (old_mask & bit) && present) {
+        node_t* const q = const_cast< node_t* >(p);
+        if(is_leaf)
+            q->set_code(q->slot(d), encode_cell(cell));
+        else {
+            release(q->children()[q->slot(d)]);
+            q->children()[q->slot(d)] = child;
+        }
+        return p;
+    }
+
+    unsigned int const mask = present ? old_mask | bit : old_mask & ~bit;
+    if(mask == 0)
+        return 0;
+    node_t* const q = allocate(is_leaf, mask);
+    unsigned int old_slot = 0;
+    unsigned int slot = 0;
+    for(std::size_t e = 0; e != 16; ++e) {
+        unsigned int const e_bit = 1u << e;
+        if(e == d) {
+            if(present) {
+                if(is_leaf)
+                    q->set_code(slot, encode_cell(cell));
+                else
+                    q->children()[slot] = child;
+                ++slot;
+            }
+        }
+        else if(old_mask & e_bit) {
+            if(is_leaf)
+                q->set_code(slot, p->code(old_slot));
+            else {
+                q->children()[slot] = p->children()[old_slot];
+                add_ref(q->children()[slot]);
+            }
+            ++slot;
+        }
+        if(old_mask & e_bit)
+            ++old_slot;
+    }
+    return q;
+}
+
+/*******************************************************************************
+ * cell_map_t::equal_(node_t const * const p, node_t const * const q) -> bool
+ ******************************************************************************/
+
+bool
+cell_map_t::
+equal_(node_t const * const p, node_t const * const q)
+{
+    if(p == q)
+        return true;
+    if(!p || !q || p->mask != q->mask)
+        return false;
+    if(p->is_leaf)
+        return std::memcmp(
+            p->codes(), q->codes(), node_t::n_code_bytes(p->mask)) == 0;
+    unsigned int const n = popcount(p->mask);
+    for(unsigned int slot = 0; slot != n; ++slot)
+        if(!equal_(p->children()[slot], q->children()[slot]))
+            return false;
+    return true;
+}
+
+/*******************************************************************************
+ * cell_map_t::hash_value() -> std::size_t
+ ******************************************************************************/
+
+namespace
+{
+
+struct hash_combine_t
+{
+    std::size_t& result;
+    explicit hash_combine_t(std::size_t& result_)
+        : result(result_)
+    { }
+    void operator()(std::size_t const offset, char const cell) const
+    {
+        boost::hash_combine(result, offset);
+        boost::hash_combine(result, cell);
+    }
+};
+
+} // namespace
+
+std::size_t
+cell_map_t::
+hash_value() const
+{
+    std::size_t result = 0;
+    for_each(hash_combine_t(result));
+    return result;
+}
+
+} // namespace icfp2012
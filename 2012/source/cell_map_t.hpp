@@ -0,0 +1,368 @@
+/*******************************************************************************
+ * icfp/2012/source/cell_map_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_CELL_MAP_T_HPP
+#define ICFP_2012_SOURCE_CELL_MAP_T_HPP
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/detail/atomic.hpp>
+
+#include "arena_t.hpp"
+#include "cell_code.hpp"
+
+namespace icfp2012
+{
+
+// A persistent map from cell offsets (see state_t::offset) to cells.  It is
+// a fixed-depth trie of 16-way nodes with the empty slots compressed away,
+// so its shape depends only on its contents.  Copies share all nodes, and an
+// assignment copies only the nodes on the path to the assigned offset which
+// are shared with another map, so each move of a delta_t costs O(log n) new
+// nodes regardless of how many cells differ from the base.  Leaves pack their
+// cells two to a byte (see encode_cell), so no cell may be a trampoline or a
+// target.  Nodes may be allocated from an arena_t (see set_arena) rather than
+// the heap.  A node holds no pointer to its arena, so that a leaf of up to 16
+// cells fits one 16-byte arena chunk along with its header; it is returned to
+// the arena of the map which releases it last.
+class cell_map_t
+{
+public:
+    explicit cell_map_t(std::size_t const n_cells);
+    cell_map_t(cell_map_t const & other);
+    ~cell_map_t();
+
+    cell_map_t& operator=(cell_map_t other);
+    void swap(cell_map_t& other);
+    inline friend void
+    swap(cell_map_t& x, cell_map_t& y)
+    { x.swap(y); }
+
+    bool empty() const;
+    std::size_t size() const;
+
+    // Nodes subsequently allocated by this map and its copies come from arena
+    // (or the heap, if arena is 0), which must outlive all of them.  Nodes
+    // are freed into the arena of the map releasing them, so a map must not
+    // outlive the maps it shares nodes with under its former arena.
+    void set_arena(arena_t* const arena_);
+    arena_t* get_arena() const;
+
+    // Returns 0 if offset is not in the map.
+    char find(std::size_t const offset) const;
+
+    void assign(std::size_t const offset, char const cell);
+    void erase(std::size_t const offset);
+
+    // Calls f(offset, cell) for each element, in order of increasing offset.
+    template< class F >
+    void for_each(F f) const;
+    // Calls f(offset) for each offset at which this map and other differ, in
+    // order of increasing offset.  Nodes the two maps share are skipped, so
+    // this takes time proportional to the differences between maps copied
+    // from one another.
+    template< class F >
+    void for_each_difference(cell_map_t const & other, F f) const;
+
+    bool operator==(cell_map_t const & other) const;
+    bool operator!=(cell_map_t const & other) const;
+
+    std::size_t hash_value() const;
+    inline friend std::size_t
+    hash_value(cell_map_t const & this_)
+    { return this_.hash_value(); }
+
+private:
+    struct node_t;
+
+    std::size_t depth;
+    std::size_t n_elements;
+    node_t const * root;
+    arena_t* arena;
+
+    static unsigned int popcount(unsigned int const mask);
+
+    std::size_t digit(std::size_t const offset, std::size_t const level) const;
+
+    static void add_ref(node_t const * const p);
+    void release(node_t const * const p) const;
+
+    node_t* allocate(bool const is_leaf, unsigned int const mask) const;
+
+    node_t const * assign_(
+        node_t const * const p,
+        std::size_t const level,
+        bool const is_unique,
+        std::size_t const offset,
+        char const cell);
+
+    template< class F >
+    static void for_each_(
+        node_t const * const p,
+        std::size_t const prefix,
+        F& f);
+
+    template< class F >
+    static void for_each_difference_(
+        node_t const * const p,
+        node_t const * const q,
+        std::size_t const prefix,
+        F& f);
+
+    static bool equal_(node_t const * const p, node_t const * const q);
+};
+
+/*******************************************************************************
+ ******************************************************************************/
+
+struct cell_map_t::node_t
+{
+    // Updated atomically, as maps on different threads may share nodes.
+    mutable boost::uint32_t volatile n_refs;
+    boost::uint16_t const mask;
+    bool const is_leaf;
+
+    node_t(bool const is_leaf_, unsigned int const mask_)
+        : n_refs(1),
+          mask(static_cast< boost::uint16_t >(mask_)),
+          is_leaf(is_leaf_)
+    { }
+
+    static std::size_t n_code_bytes(unsigned int const mask_)
+    { return (popcount(mask_) + 1) / 2; }
+
+    static std::size_t size(bool const is_leaf_, unsigned int const mask_)
+    {
+        return sizeof( node_t ) + (is_leaf_ ?
+            n_code_bytes(mask_) :
+            popcount(mask_) * sizeof( node_t const * ));
+    }
+
+    // The popcount(mask) children (if !is_leaf) or cell codes (if is_leaf,
+    // the code of slot 2k in the low half of byte k and that of slot 2k+1 in
+    // the high half, which is 0 past the last slot) are allocated
+    // immediately after the node.
+    node_t const * * children()
+    { return reinterpret_cast< node_t const * * >(this + 1); }
+    node_t const * const * children() const
+    { return reinterpret_cast< node_t const * const * >(this + 1); }
+    boost::uint8_t* codes()
+    { return reinterpret_cast< boost::uint8_t* >(this + 1); }
+    boost::uint8_t const * codes() const
+    { return reinterpret_cast< boost::uint8_t const * >(this + 1); }
+
+    unsigned int code(unsigned int const slot) const
+    { return codes()[slot / 2] >> 4 * (slot % 2) & 15; }
+    char cell(unsigned int const slot) const
+    { return decode_cell(code(slot)); }
+    void set_code(unsigned int const slot, unsigned int const code_)
+    {
+        boost::uint8_t& byte = codes()[slot / 2];
+        unsigned int const shift = 4 * (slot % 2);
+        byte = static_cast< boost::uint8_t >(
+            (byte & ~(15u << shift)) | code_ << shift);
+    }
+
+    unsigned int slot(std::size_t const digit) const
+    { return popcount(mask & ((1u << digit) - 1)); }
+};
+
+/*******************************************************************************
+ ******************************************************************************/
+
+inline
+cell_map_t::
+cell_map_t(cell_map_t const & other)
+    : depth(other.depth),
+      n_elements(other.n_elements),
+      root(other.root),
+      arena(other.arena)
+{ add_ref(root); }
+
+inline
+cell_map_t::
+~cell_map_t()
+{ release(root); }
+
+inline cell_map_t&
+cell_map_t::
+operator=(cell_map_t other)
+{
+    swap(other);
+    return *this;
+}
+
+inline void
+cell_map_t::
+swap(cell_map_t& other)
+{
+    std::swap(depth, other.depth);
+    std::swap(n_elements, other.n_elements);
+    std::swap(root, other.root);
+    std::swap(arena, other.arena);
+}
+
+inline bool
+cell_map_t::
+empty() const
+{ return n_elements == 0; }
+
+inline std::size_t
+cell_map_t::
+size() const
+{ return n_elements; }
+
+inline void
+cell_map_t::
+set_arena(arena_t* const arena_)
+{ arena = arena_; }
+
+inline arena_t*
+cell_map_t::
+get_arena() const
+{ return arena; }
+
+inline unsigned int
+cell_map_t::
+popcount(unsigned int mask)
+{
+    mask = mask - ((mask >> 1) & 0x5555u);
+    mask = (mask & 0x3333u) + ((mask >> 2) & 0x3333u);
+    mask = (mask + (mask >> 4)) & 0x0f0fu;
+    return (mask + (mask >> 8)) & 0x1fu;
+}
+
+inline std::size_t
+cell_map_t::
+digit(std::size_t const offset, std::size_t const level) const
+{ return (offset >> 4 * (depth - 1 - level)) & 15; }
+
+inline void
+cell_map_t::
+add_ref(node_t const * const p)
+{
+    if(p)
+        boost::interprocess::ipcdetail::atomic_inc32(&p->n_refs);
+}
+
+inline char
+cell_map_t::
+find(std::size_t const offset) const
+{
+    node_t const * p = root;
+    for(std::size_t level = 0; p; ++level) {
+        std::size_t const d = digit(offset, level);
+        if(!(p->mask >> d & 1))
+            return 0;
+        if(p->is_leaf)
+            return p->cell(p->slot(d));
+        p = p->children()[p->slot(d)];
+    }
+    return 0;
+}
+
+inline void
+cell_map_t::
+erase(std::size_t const offset)
+{ assign(offset, 0); }
+
+template< class F >
+inline void
+cell_map_t::
+for_each(F f) const
+{
+    if(root)
+        for_each_(root, 0, f);
+}
+
+template< class F >
+void
+cell_map_t::
+for_each_(
+    node_t const * const p,
+    std::size_t const prefix,
+    F& f)
+{
+    unsigned int slot = 0;
+    for(std::size_t d = 0; d != 16; ++d) {
+        if(!(p->mask >> d & 1))
+            continue;
+        std::size_t const offset = prefix << 4 | d;
+        if(p->is_leaf)
+            f(offset, p->cell(slot));
+        else
+            for_each_(p->children()[slot], offset, f);
+        ++slot;
+    }
+}
+
+template< class F >
+inline void
+cell_map_t::
+for_each_difference(cell_map_t const & other, F f) const
+{
+    assert(depth == other.depth);
+    for_each_difference_(root, other.root, 0, f);
+}
+
+template< class F >
+void
+cell_map_t::
+for_each_difference_(
+    node_t const * const p,
+    node_t const * const q,
+    std::size_t const prefix,
+    F& f)
+{
+    if(p == q)
+        return;
+    unsigned int const p_mask = p ? p->mask : 0;
+    unsigned int const q_mask = q ? q->mask : 0;
+    bool const is_leaf = p ? p->is_leaf : q->is_leaf;
+    unsigned int p_slot = 0;
+    unsigned int q_slot = 0;
+    for(std::size_t d = 0; d != 16; ++d) {
+        bool const p_has = (p_mask >> d & 1) != 0;
+        bool const q_has = (q_mask >> d & 1) != 0;
+        if(!p_has && !q_has)
+            continue;
+        std::size_t const offset = prefix << 4 | d;
+        if(is_leaf) {
+            if(!p_has || !q_has || p->code(p_slot) != q->code(q_slot))
+                f(offset);
+        }
+        else
+            for_each_difference_(
+                p_has ? p->children()[p_slot] : 0,
+                q_has ? q->children()[q_slot] : 0,
+                offset, f);
+        p_slot += p_has;
+        q_slot += q_has;
+    }
+}
+
+inline bool
+cell_map_t::
+operator==(cell_map_t const & other) const
+{
+    assert(depth == other.depth);
+    return n_elements == other.n_elements && equal_(root, other.root);
+}
+
+inline bool
+cell_map_t::
+operator!=(cell_map_t const & other) const
+{ return !operator==(other); }
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_CELL_MAP_T_HPP
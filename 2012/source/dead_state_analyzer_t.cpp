@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * icfp/2012/source/dead_state_analyzer_t.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cstddef>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+
+#include "dead_state_analyzer_t.hpp"
+#include "delta_t.hpp"
+#include "distance_fields_t.hpp"
+#include "feature_e.hpp"
+#include "index_t.hpp"
+#include "state_t.hpp"
+
+namespace icfp2012
+{
+
+namespace
+{
+
+// The most moves dead_state_analyzer_t::min_rows looks ahead.
+std::size_t const max_n_water_moves = 32;
+
+} // namespace
+
+/*******************************************************************************
+ * dead_state_analyzer_t::dead_state_analyzer_t(state_t const & start)
+ ******************************************************************************/
+
+dead_state_analyzer_t::
+dead_state_analyzer_t(state_t const & start)
+    : distance_fields(simplified(start)),
+      unreachable_lambdas(start.cells.size()),
+      lift_approach_row(start.n_rows)
+{
+    for(std::size_t i = 1; i != start.n_rows - 1; ++i)
+        for(std::size_t j = 1; j != start.n_cols - 1; ++j)
+            if(start[i][j] == '\\')
+                lambda_indices.push_back(index_t(i,j));
+    for(std::size_t i = 1; i != start.n_rows - 1; ++i) {
+        for(std::size_t j = 1; j != start.n_cols - 1; ++j) {
+            index_t const index(i,j);
+            std::vector< index_t >& unreachable =
+                unreachable_lambdas[start.offset(index)];
+            BOOST_FOREACH( index_t const lambda_index, lambda_indices )
+                if(distance_fields.lambda_distance(lambda_index, index)
+                == distance_fields_t::infinity)
+                    unreachable.push_back(lambda_index);
+        }
+    }
+
+    if(!(start.features & feature_e_water))
+        return;
+    std::size_t const n_lift_approach_moves = start.waterproof + 1;
+    for(std::size_t i = 1; i != start.n_rows - 1; ++i)
+        for(std::size_t j = 1; j != start.n_cols - 1; ++j)
+            if(distance_fields.lift_distance(index_t(i,j))
+            <= n_lift_approach_moves)
+                lift_approach_row = std::min(lift_approach_row, i);
+    min_rows.resize(std::min(n_lift_approach_moves, max_n_water_moves) + 1);
+    min_rows[0].resize(start.cells.size());
+    for(std::size_t offset = 0; offset != start.cells.size(); ++offset)
+        min_rows[0][offset] =
+            static_cast< boost::uint16_t >(offset / start.n_cols);
+    min_rows[0][start.offset(start.lift_index)] = 0;
+    std::vector< std::size_t > neighbors;
+    for(std::size_t k = 1; k != min_rows.size(); ++k) {
+        std::vector< boost::uint16_t > const & last_rows = min_rows[k-1];
+        std::vector< boost::uint16_t >& rows = min_rows[k];
+        rows = last_rows;
+        for(std::size_t i = 1; i != start.n_rows - 1; ++i) {
+            for(std::size_t j = 1; j != start.n_cols - 1; ++j) {
+                index_t const index(i,j);
+                boost::uint16_t& row = rows[start.offset(index)];
+                if(distance_fields.lift_distance(index) <= k) {
+                    row = 0;
+                    continue;
+                }
+                distance_fields.neighbors(start.offset(index), neighbors);
+                BOOST_FOREACH( std::size_t const neighbor, neighbors )
+                    row = std::min(row, last_rows[neighbor]);
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * dead_state_analyzer_t::max_score(delta_t const & state) const -> int
+ ******************************************************************************/
+
+int
+dead_state_analyzer_t::
+max_score(delta_t const & state) const
+{
+    if(state.robot_index == state.base.lift_index
+    || state.robot_is_destroyed)
+        return state.score();
+
+    // Lambdas created since the start (by falling higher order rocks) are
+    // taken to be reachable.
+    int n_unreachable = 0;
+    BOOST_FOREACH(
+        index_t const lambda_index,
+        unreachable_lambdas[state.base.offset(state.robot_index)] )
+        n_unreachable += state[lambda_index] == '\\';
+
+    int const n_lambdas_collected = static_cast< int >(
+        state.base.n_lambdas_collected
+      + (state.base.n_lambdas_remaining - state.n_lambdas_remaining));
+    int const n_lambdas_remaining =
+        static_cast< int >(state.n_lambdas_remaining);
+    int n_reachable = n_lambdas_remaining - n_unreachable;
+    int const n_turns = static_cast< int >(state.n_turns);
+    distance_fields_t::distance_type const lift_distance =
+        distance_fields.lift_distance(state.robot_index);
+    bool lift_is_lost =
+        n_unreachable != 0 || lift_distance == distance_fields_t::infinity;
+
+    if(!min_rows.empty()) {
+        // The robot drowns unless it gets to a cell above the water (or to
+        // the lift) within n_surfacing_moves moves, and with the water only
+        // rising, no cell which is under water now will do.  Row 0 is wall, so
+        // the lift is above even a water level of 0.
+        std::size_t const n_surfacing_moves =
+            state.base.waterproof - state.n_turns_underwater + 1;
+        unsigned int const water_level =
+            std::max(state.water_level(), 1u);
+        if(n_surfacing_moves < min_rows.size()
+        && min_rows[n_surfacing_moves][state.base.offset(state.robot_index)]
+        >= water_level) {
+            lift_is_lost = true;
+            BOOST_FOREACH( index_t const lambda_index, lambda_indices ) {
+                distance_fields_t::distance_type const distance =
+                    distance_fields.lambda_distance(
+                        lambda_index, state.robot_index);
+                n_reachable -= state[lambda_index] == '\\'
+                            && distance != distance_fields_t::infinity
+                            && distance > n_surfacing_moves;
+            }
+        }
+        else if(!lift_is_lost)
+            lift_is_lost = lift_bonus_is_flooded(state, n_surfacing_moves);
+    }
+
+    // Each reachable lambda takes at least one more move to collect.
+    int const abort_bound =
+        50 * (n_lambdas_collected + n_reachable) - n_turns - n_reachable;
+    if(lift_is_lost)
+        return abort_bound;
+    return std::max(
+        75 * (n_lambdas_collected + n_lambdas_remaining) - n_turns
+      - std::max(n_lambdas_remaining + 1, static_cast< int >(lift_distance)),
+        abort_bound);
+}
+
+/*******************************************************************************
+ * dead_state_analyzer_t::lift_bonus_is_flooded(
+ *     delta_t const & state,
+ *     std::size_t const n_surfacing_moves) const
+ *     -> bool
+ *
+ * Whether the water keeps the robot, which must get above it within
+ * n_surfacing_moves moves, from the lift or from collecting a remaining lambda
+ * and getting back out.  The robot gets to each no sooner than it is away from
+ * it, with the water no lower than then.
+ ******************************************************************************/
+
+bool
+dead_state_analyzer_t::
+lift_bonus_is_flooded(
+    delta_t const & state,
+    std::size_t const n_surfacing_moves) const
+{
+    if(distance_fields.lift_distance(state.robot_index) > n_surfacing_moves
+    && lift_approach_row >= std::max(state.water_level(), 1u))
+        return true;
+    // Under water at a lambda, the robot has at most waterproof moves left in
+    // which to get out.
+    std::size_t const waterproof = state.base.waterproof;
+    if(waterproof >= min_rows.size())
+        return false;
+    BOOST_FOREACH( index_t const lambda_index, lambda_indices ) {
+        if(state[lambda_index] != '\\')
+            continue;
+        distance_fields_t::distance_type const distance =
+            distance_fields.lambda_distance(lambda_index, state.robot_index);
+        if(distance == distance_fields_t::infinity)
+            continue;
+        unsigned int const water_level =
+            std::max(state.water_level(state.n_turns + distance), 1u);
+        if(lambda_index.i() >= water_level
+        && min_rows[waterproof][state.base.offset(lambda_index)]
+        >= water_level)
+            return true;
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * dead_state_analyzer_t::simplified(state_t state) -> state_t
+ ******************************************************************************/
+
+state_t
+dead_state_analyzer_t::
+simplified(state_t state)
+{
+    state.simplify_ip();
+    return state;
+}
+
+} // namespace icfp2012
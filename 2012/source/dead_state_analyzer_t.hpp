@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * icfp/2012/source/dead_state_analyzer_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_DEAD_STATE_ANALYZER_T_HPP
+#define ICFP_2012_SOURCE_DEAD_STATE_ANALYZER_T_HPP
+
+#include <cstddef>
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "delta_t.hpp"
+#include "distance_fields_t.hpp"
+#include "index_t.hpp"
+#include "state_t.hpp"
+
+namespace icfp2012
+{
+
+// Bounds the score reachable from the states of a game by what the start state
+// already rules out.  Walls and unmovable rocks (as marked by
+// state_t::simplify_ip on the start state) never go away, so a lambda the
+// robot cannot walk to past them now is lost for good, and with it the lift,
+// which then never opens; and the lift bonus takes at least as many more moves
+// as the robot is away from the lift.  Water only rises, so the robot drowns
+// if it cannot get to a cell above the current water level (or to the lift)
+// before its waterproofing runs out, after collecting only the lambdas it
+// gets to first; and the lift bonus is lost if the lift, or any lambda, is
+// under water by the time the robot could get to it and too far from such a
+// cell for the robot to get back out.  max_score is thus a tighter
+// delta_t::max_score, and a state is dead once it is no higher than the best
+// score already found: no continuation of it can do better.
+class dead_state_analyzer_t
+{
+public:
+    // start must be a state of the same game as (and no later than) every
+    // state later passed to max_score or is_dead; it need not be simplified.
+    explicit dead_state_analyzer_t(state_t const & start);
+
+    int max_score(delta_t const & state) const;
+    bool is_dead(delta_t const & state, int const best_score) const;
+
+private:
+    distance_fields_t distance_fields;
+    // unreachable_lambdas[offset] holds the indices of the lambdas of the start
+    // state the robot can never reach from offset.
+    std::vector< std::vector< index_t > > unreachable_lambdas;
+    // The lambdas of the start state.
+    std::vector< index_t > lambda_indices;
+    // Only for a game with water: min_rows[k][offset] is the least row of any
+    // cell the robot can get to from offset in at most k moves, or 0 if that
+    // includes the lift, for k up to the start state's waterproof + 1 (but no
+    // more than a fixed cap).  Each field holds a row per cell, so the cap
+    // bounds their memory.
+    std::vector< std::vector< boost::uint16_t > > min_rows;
+    // The least row of any cell from which the robot can get to the lift in at
+    // most waterproof + 1 moves.
+    std::size_t lift_approach_row;
+
+    bool lift_bonus_is_flooded(
+        delta_t const & state,
+        std::size_t const n_surfacing_moves) const;
+
+    static state_t simplified(state_t state);
+};
+
+/*******************************************************************************
+ ******************************************************************************/
+
+inline bool
+dead_state_analyzer_t::
+is_dead(delta_t const & state, int const best_score) const
+{ return max_score(state) <= best_score; }
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_DEAD_STATE_ANALYZER_T_HPP
@@ -9,19 +9,25 @@
 #include <cassert>
 #include <cstddef>
 
+#include <algorithm>
 #include <deque>
-#include <set>
 #include <utility>
+#include <vector>
 
 #include <boost/foreach.hpp>
-#include <boost/unordered_set.hpp>
+#include <boost/optional.hpp>
 
+#include "arena_t.hpp"
 #include "cell_is_active.hpp"
+#include "cell_map_t.hpp"
 #include "delta_t.hpp"
+#include "feature_e.hpp"
 #include "index_t.hpp"
+#include "simplify_ip.hpp"
 #include "state_t.hpp"
 #include "update_compare_t.hpp"
-#include "update_rock.hpp"
+#include "update_source_t.hpp"
+#include "world_timeline_t.hpp"
 
 namespace icfp2012
 {
@@ -33,6 +39,8 @@ namespace icfp2012
 delta_t::
 delta_t(state_t const & base_)
     : base(base_),
+      cell_map(base.cells.size()),
+      cells_hash(0),
       robot_index(base.robot_index),
       active_indices(base.active_indices),
       n_turns(base.n_turns),
@@ -42,40 +50,161 @@ delta_t(state_t const & base_)
       n_razors(base.n_razors)
 { }
 
-/*******************************************************************************
- * delta_t::move_robot_update(char const move) -> delta_t
- ******************************************************************************/
+namespace
+{
 
-delta_t
-delta_t::
-move_robot_update(char const move) const
+// The cells of a delta_t around the robot, copied out of its cell_map as they
+// are first read, so the many reads the world update makes near the robot
+// need few lookups.  Reads further away go to the delta_t, and every write to
+// the delta_t must be repeated here (see assign).
+struct window_t
 {
-    assert(!robot_is_destroyed);
-    assert(move_is_valid(move));
+    static std::size_t const radius = 3;
+    static std::size_t const size = 2 * radius + 1;
 
-    delta_t result(base,0);
-    result.cell_map = cell_map;
-    result.robot_index = robot_index + move;
-    result.n_turns = n_turns + 1;
-    result.n_lambdas_remaining = n_lambdas_remaining;
-    result.n_turns_underwater = n_turns_underwater;
-    result.n_razors = n_razors;
+    delta_t const * state;
+    // May wrap around, as may the differences taken from them, so these are
+    // not an index_t.
+    std::size_t corner_i;
+    std::size_t corner_j;
+    // 0 marks a cell not yet read.
+    mutable char cells[size][size];
+
+    window_t(delta_t const & state_, index_t const center)
+        : state(&state_),
+          corner_i(center.i() - radius),
+          corner_j(center.j() - radius)
+    { std::fill(&cells[0][0], &cells[0][0] + size * size, 0); }
 
-    std::deque< index_t > new_empty_indices;
+    char operator[](index_t const index) const
+    {
+        std::size_t const i = index.i() - corner_i;
+        std::size_t const j = index.j() - corner_j;
+        if(!(i < size && j < size))
+            return (*state)[index];
+        char& cell = cells[i][j];
+        if(cell == 0)
+            cell = (*state)[index];
+        return cell;
+    }
+
+    void assign(index_t const index, char const cell)
+    {
+        std::size_t const i = index.i() - corner_i;
+        std::size_t const j = index.j() - corner_j;
+        if(i < size && j < size)
+            cells[i][j] = cell;
+    }
+};
+
+// The sources computed from the state a batch of moves is made from, which
+// serve every move which changes no cell near them (see is_near), and buffers
+// reused from one move of the batch to the next.
+struct sibling_cache_t
+{
+    explicit sibling_cache_t(delta_t const & state)
+        : window(state, state.robot_index)
+    { }
+
+    std::vector< update_source_t > sources;
+    std::vector< cell_update_t > updates;
+    // The cells around the robot of the state the moves are made from.
+    window_t window;
+
+    std::vector< index_t > changed_indices;
+    std::vector< index_t > new_empty_indices;
+    std::vector< update_source_t > update_srces;
+    std::vector< cell_update_t > move_updates;
+    std::vector< cell_update_t > update_dests;
+    std::vector< index_t > old_active_beards;
+    std::vector< index_t > active_indices;
+
+    // The cells in which the state the moves are made from differs from the
+    // timeline frame of its turn, in order, if the moves are made from the
+    // timeline; and buffers for those moves.
+    std::vector< index_t > deviations;
+    std::vector< index_t > moved_deviations;
+    std::vector< index_t > touched_indices;
+    std::vector< char > touched_cells;
+    std::vector< index_t > result_deviations;
+};
+
+// Whether the source at index may be classified differently once the cells
+// of changed_indices have changed.
+bool is_near(index_t const index, std::vector< index_t > const & changed_indices)
+{
+    std::size_t const i = index.i();
+    std::size_t const j = index.j();
+    BOOST_FOREACH( index_t const changed_index, changed_indices ) {
+        if(i + 2 >= changed_index.i() && changed_index.i() + 2 >= i
+        && j + 2 >= changed_index.j() && changed_index.j() + 2 >= j)
+            return true;
+    }
+    return false;
+}
 
-    // Move robot.
+// As above, but for indices in order, and within radius rows and columns.
+bool is_near(
+    index_t const index,
+    std::vector< index_t > const & indices,
+    std::size_t const radius)
+{
+    if(indices.empty())
+        return false;
+    std::size_t const first_i = index.i() >= radius ? index.i() - radius : 0;
+    std::size_t const first_j = index.j() >= radius ? index.j() - radius : 0;
+    for(std::size_t i = first_i; i != index.i() + radius + 1; ++i) {
+        std::vector< index_t >::const_iterator const it = std::lower_bound(
+            indices.begin(), indices.end(), index_t(i, first_j));
+        if(it != indices.end() && it->i() == i && it->j() <= index.j() + radius)
+            return true;
+    }
+    return false;
+}
+
+struct push_index_t
+{
+    std::size_t const n_cols;
+    std::vector< index_t >& indices;
+    push_index_t(std::size_t const n_cols_, std::vector< index_t >& indices_)
+        : n_cols(n_cols_), indices(indices_)
+    { }
+    void operator()(std::size_t const offset) const
+    { indices.push_back(index_t(offset / n_cols, offset % n_cols)); }
+};
+
+// Whether the beards of base grow on turn n_turns.
+template< class Features >
+bool beards_grow(state_t const & base, unsigned int const n_turns)
+{
+    return Features::beards
+        && base.beard_growth_rate != 0
+        && n_turns % base.beard_growth_rate == 0;
+}
+
+// Moves the robot of result, a copy of state, by move, recording the cells it
+// changes (and those it empties) and returning whether it pushes a rock.
+template< class Features >
+bool move_robot(
+    delta_t const & state,
+    char const move,
+    delta_t& result,
+    std::vector< index_t >& changed_indices,
+    std::vector< index_t >& new_empty_indices)
+{
+    index_t const robot_index = state.robot_index;
     bool rock_is_moved = false;
     switch(move) {
     case 'W':
         break;
     case 'S':
-        if(n_razors == 0)
+        if(!Features::beards || state.n_razors == 0)
             break;
         --result.n_razors;
-        for(std::size_t i = robot_index.i-1; i != robot_index.i+2; ++i) {
-            for(std::size_t j = robot_index.j-1; j != robot_index.j+2; ++j) {
+        for(std::size_t i = robot_index.i()-1; i != robot_index.i()+2; ++i) {
+            for(std::size_t j = robot_index.j()-1; j != robot_index.j()+2; ++j) {
                 index_t const index(i,j);
-                if(operator[](index) != 'W')
+                if(state[index] != 'W')
                     continue;
                 result[index] = ' ';
                 new_empty_indices.push_back(index);
@@ -83,13 +212,14 @@ move_robot_update(char const move) const
         }
         break;
     default: {
-        char const dest_cell = operator[](result.robot_index);
+        char const dest_cell = state[result.robot_index];
         switch(dest_cell) {
         case '*':
         case '@':
             assert(move == 'L' || move == 'R');
-            assert(operator[](result.robot_index + move) == ' ');
+            assert(state[result.robot_index + move] == ' ');
             result[result.robot_index + move] = dest_cell;
+            changed_indices.push_back(result.robot_index + move);
             rock_is_moved = true;
             goto CASE_COMMON;
         case '\\':
@@ -103,11 +233,15 @@ move_robot_update(char const move) const
         case ' ':
             goto CASE_COMMON;
         default:
+            assert(Features::trampolines);
             assert('A' <= dest_cell && dest_cell <= 'I');
-            result.robot_index = base.trampoline_map[dest_cell];
+            if(!Features::trampolines)
+                break;
+            changed_indices.push_back(result.robot_index);
+            result.robot_index = state.base.trampoline_map[dest_cell];
             BOOST_FOREACH(
                 index_t const trampoline_index,
-                base.target_map[operator[](result.robot_index)] ) {
+                state.base.target_map[state[result.robot_index]] ) {
                 result[trampoline_index] = ' ';
                 new_empty_indices.push_back(trampoline_index);
             }
@@ -115,140 +249,620 @@ move_robot_update(char const move) const
             result[robot_index] = ' ';
             new_empty_indices.push_back(robot_index);
             result[result.robot_index] = 'R';
+            changed_indices.push_back(result.robot_index);
             break;
         }
     }}
+    changed_indices.insert(
+        changed_indices.end(),
+        new_empty_indices.begin(), new_empty_indices.end());
+    return rock_is_moved;
+}
+
+// Applies the rules of the lift and the water to result, whose world has just
+// been updated.
+template< class Features >
+void check_conditions(delta_t& result)
+{
+    state_t const & base = result.base;
+    if(result.robot_index == base.lift_index)
+        result.robot_is_destroyed = false;
+    else {
+        if(result.n_lambdas_remaining == 0)
+            result[base.lift_index] = 'O';
+        if(!Features::water)
+            assert(result.n_turns_underwater == 0);
+        else if(result.robot_index.i() < result.water_level())
+            result.n_turns_underwater = 0;
+        else if(++result.n_turns_underwater > base.waterproof)
+            result.robot_is_destroyed = true;
+    }
+}
+
+// Updates the world of result, whose robot has just moved (see move_robot),
+// reusing the sources of cache, if it has any, away from the changed cells.
+template< class Features >
+void update_world(
+    delta_t const & state,
+    char const move,
+    delta_t& result,
+    bool const rock_is_moved,
+    sibling_cache_t& cache)
+{
+    std::vector< index_t > const & changed_indices = cache.changed_indices;
+    std::vector< index_t > const & new_empty_indices = cache.new_empty_indices;
+    bool const has_sources = !cache.sources.empty();
+
+    window_t window = cache.window;
+    window.state = &result;
+    BOOST_FOREACH( index_t const index, changed_indices )
+        window.assign(index, result[index]);
 
-    bool const grow_beards = base.beard_growth_rate != 0
-                          && result.n_turns % base.beard_growth_rate == 0;
+    bool const grow_beards =
+        beards_grow< Features >(state.base, result.n_turns);
 
-    boost::unordered_set< index_t > old_active_beards;
+    std::vector< index_t >& old_active_beards = cache.old_active_beards;
 
-    // Determine which cells need updating.
-    std::set< index_t, update_compare_t > update_srces;
+    // Determine which cells need updating, and how.
+    std::vector< update_source_t >& update_srces = cache.update_srces;
+    std::vector< cell_update_t >& updates = cache.move_updates;
     if(rock_is_moved) {
-        index_t const index = result.robot_index + move;
-        if(cell_is_active(result, index))
-            update_srces.insert(index);
+        update_source_t const source = classify_source< Features >(
+            window, result.robot_index + move, grow_beards, updates);
+        if(source.is_active)
+            update_srces.push_back(source);
     }
-    BOOST_FOREACH( index_t const index, active_indices ) {
-        if(cell_is_active(result, index)) {
-            if(grow_beards || result[index] != 'W')
-                update_srces.insert(index);
-            else
-                old_active_beards.insert(index);
+    for(std::size_t k = 0; k != state.active_indices.size(); ++k) {
+        index_t const index = state.active_indices[k];
+        update_source_t source;
+        if(has_sources && !is_near(index, changed_indices)) {
+            source = cache.sources[k];
+            assert(source.index == index);
+            std::size_t const first_update = source.first_update;
+            source.first_update = updates.size();
+            updates.insert(
+                updates.end(),
+                cache.updates.begin() + first_update,
+                cache.updates.begin() + first_update + source.n_updates);
         }
+        else
+            source = classify_source< Features >(
+                window, index, grow_beards, updates);
+        if(source.is_updated)
+            update_srces.push_back(source);
+        else if(source.is_active)
+            old_active_beards.push_back(index);
     }
     BOOST_FOREACH( index_t const index, new_empty_indices ) {
         assert(result[index] == ' ');
-        for(std::size_t i = index.i-1; i != index.i+2; ++i) {
-            for(std::size_t j = index.j-1; j != index.j+2; ++j) {
-                if(j >= base[i].size())
-                    continue;
-                index_t const adj_index(i,j);
-                if(cell_is_active(result, adj_index)) {
-                    if(grow_beards || result[adj_index] != 'W')
-                        update_srces.insert(adj_index);
-                    else
-                        old_active_beards.insert(adj_index);
-                }
+        for(std::size_t i = index.i()-1; i != index.i()+2; ++i) {
+            for(std::size_t j = index.j()-1; j != index.j()+2; ++j) {
+                update_source_t const source = classify_source< Features >(
+                    window, index_t(i,j), grow_beards, updates);
+                if(source.is_updated)
+                    update_srces.push_back(source);
+                else if(source.is_active)
+                    old_active_beards.push_back(source.index);
             }
         }
     }
-
-    // Determine how cells should be updated.
-    typedef std::pair< index_t, char > update_type;
-    std::deque< update_type > update_dests;
-    BOOST_FOREACH( index_t const index, update_srces ) {
-        assert(cell_is_active(result, index));
-        char const cell = result[index];
-        switch(cell) {
-        case '*':
-        case '@': {
-            index_t const dest_index = update_rock(result, index);
-            if(dest_index == index)
-                break;
-            update_dests.push_back(update_type(index, ' '));
-            update_dests.push_back(update_type(dest_index,
-                cell == '@' && result[dest_index + 'D'] != ' ' ? '\\' : cell));
-            break;
-        }
-        case 'W':
-            assert(grow_beards);
-            for(std::size_t i = index.i-1; i != index.i+2; ++i) {
-                for(std::size_t j = index.j-1; j != index.j+2; ++j) {
-                    index_t const adj_index(i,j);
-                    if(result[adj_index] == ' ')
-                        update_dests.push_back(update_type(adj_index, 'W'));
-                }
-            }
-            break;
-        default:
-            assert(false);
-        }
+    // Sources are updated from the bottom row up.  A cell may be a source
+    // more than once, but is classified the same each time.
+    std::stable_sort(
+        update_srces.begin(), update_srces.end(), update_source_compare_t());
+    update_srces.erase(
+        std::unique(
+            update_srces.begin(), update_srces.end(), update_source_equal_t()),
+        update_srces.end());
+    std::vector< cell_update_t >& update_dests = cache.update_dests;
+    BOOST_FOREACH( update_source_t const & source, update_srces ) {
+        assert(cell_is_active(result, source.index));
+        update_dests.insert(
+            update_dests.end(),
+            updates.begin() + source.first_update,
+            updates.begin() + source.first_update + source.n_updates);
     }
     update_srces.clear();
+    updates.clear();
 
     // Apply updates.
     result.robot_is_destroyed = false;
-    BOOST_FOREACH( update_type const update, update_dests ) {
+    BOOST_FOREACH( cell_update_t const update, update_dests ) {
         index_t const index = update.first;
         char const cell = update.second;
         result[index] = cell;
-        if(result[index + 'D'] == 'R') {
-            assert(cell != 'W');
+        window.assign(index, cell);
+        if(window[index + 'D'] == 'R') {
+            assert(cell != '@');
             result.robot_is_destroyed = cell == '*' || cell == '\\';
         }
     }
 
     // Determine new set of active cells.
-    boost::unordered_set< index_t > result_active_indices_hash;
+    std::vector< index_t >& result_active_indices = cache.active_indices;
     BOOST_FOREACH( index_t const index, old_active_beards )
-        if(cell_is_active(result, index))
-            result_active_indices_hash.insert(index);
+        if(cell_is_active(window, index))
+            result_active_indices.push_back(index);
     old_active_beards.clear();
-    BOOST_FOREACH( update_type const update, update_dests ) {
+    BOOST_FOREACH( cell_update_t const update, update_dests ) {
         index_t const index = update.first;
         char const cell = update.second;
         assert(result[index] == cell);
         if(cell == ' ') {
-            for(std::size_t i = index.i-1; i != index.i+2; ++i) {
-                for(std::size_t j = index.j-1; j != index.j+2; ++j) {
-                    if(j >= base[i].size())
-                        continue;
+            for(std::size_t i = index.i()-1; i != index.i()+2; ++i) {
+                for(std::size_t j = index.j()-1; j != index.j()+2; ++j) {
                     index_t const adj_index(i,j);
-                    if(cell_is_active(result, adj_index))
-                        result_active_indices_hash.insert(adj_index);
+                    if(cell_is_active(window, adj_index))
+                        result_active_indices.push_back(adj_index);
                 }
             }
         }
-        else if(cell_is_active(result, index))
-            result_active_indices_hash.insert(index);
+        else if(cell_is_active(window, index))
+            result_active_indices.push_back(index);
     }
     update_dests.clear();
-    result.active_indices.insert(
-        result.active_indices.end(),
-        result_active_indices_hash.begin(), result_active_indices_hash.end());
+    std::sort(
+        result_active_indices.begin(), result_active_indices.end(),
+        update_compare_t());
+    result.active_indices.assign(
+        result_active_indices.begin(),
+        std::unique(result_active_indices.begin(), result_active_indices.end()));
+    result_active_indices.clear();
 
-    // Check special conditions.
-    if(result.robot_index == base.lift_index)
-        result.robot_is_destroyed = false;
-    else {
-        if(result.n_lambdas_remaining == 0)
-            result[base.lift_index] = 'O';
-        if(result.robot_index.i < water_level())
-            result.n_turns_underwater = 0;
-        else if(++result.n_turns_underwater > base.waterproof)
-            result.robot_is_destroyed = true;
+    check_conditions< Features >(result);
+}
+
+// As above, but from the timeline frames of the turns of state and result.  A
+// source away from the cells in which the moved state differs from
+// frame.world updates as it does there, so only the sources near those cells
+// are classified, and result takes the cells of next_frame.world but for those
+// the update may leave otherwise: the differing cells, and the destinations of
+// the near sources of either.  Likewise, result's active cells are those of
+// next_frame.world but around the cells in which the two differ.
+template< class Features >
+void update_world(
+    delta_t const & state,
+    char const move,
+    delta_t& result,
+    bool const rock_is_moved,
+    world_timeline_t::frame_t const & frame,
+    world_timeline_t::frame_t const & next_frame,
+    sibling_cache_t& cache)
+{
+    std::vector< index_t > const & changed_indices = cache.changed_indices;
+    std::vector< index_t > const & new_empty_indices = cache.new_empty_indices;
+
+    std::vector< index_t >& moved_deviations = cache.moved_deviations;
+    moved_deviations.assign(cache.deviations.begin(), cache.deviations.end());
+    moved_deviations.insert(
+        moved_deviations.end(), changed_indices.begin(), changed_indices.end());
+    std::sort(moved_deviations.begin(), moved_deviations.end());
+    moved_deviations.erase(
+        std::unique(moved_deviations.begin(), moved_deviations.end()),
+        moved_deviations.end());
+
+    window_t window = cache.window;
+    window.state = &result;
+    BOOST_FOREACH( index_t const index, changed_indices )
+        window.assign(index, result[index]);
+
+    bool const grow_beards =
+        beards_grow< Features >(state.base, result.n_turns);
+
+    // Determine which cells need updating, and how.
+    std::vector< update_source_t >& update_srces = cache.update_srces;
+    std::vector< cell_update_t >& updates = cache.move_updates;
+    if(rock_is_moved) {
+        update_source_t const source = classify_source< Features >(
+            window, result.robot_index + move, grow_beards, updates);
+        if(source.is_updated)
+            update_srces.push_back(source);
+    }
+    BOOST_FOREACH( index_t const index, state.active_indices ) {
+        if(!is_near(index, moved_deviations, 2))
+            continue;
+        update_source_t const source =
+            classify_source< Features >(window, index, grow_beards, updates);
+        if(source.is_updated)
+            update_srces.push_back(source);
+    }
+    BOOST_FOREACH( index_t const index, new_empty_indices ) {
+        assert(result[index] == ' ');
+        for(std::size_t i = index.i()-1; i != index.i()+2; ++i) {
+            for(std::size_t j = index.j()-1; j != index.j()+2; ++j) {
+                update_source_t const source = classify_source< Features >(
+                    window, index_t(i,j), grow_beards, updates);
+                if(source.is_updated)
+                    update_srces.push_back(source);
+            }
+        }
+    }
+    std::vector< index_t >& touched_indices = cache.touched_indices;
+    touched_indices.assign(moved_deviations.begin(), moved_deviations.end());
+    BOOST_FOREACH( cell_update_t const update, updates )
+        touched_indices.push_back(update.first);
+    BOOST_FOREACH( update_source_t source, frame.sources ) {
+        std::vector< cell_update_t >::const_iterator const first_update =
+            frame.updates.begin() + source.first_update;
+        if(is_near(source.index, moved_deviations, 2)) {
+            for(std::size_t k = 0; k != source.n_updates; ++k)
+                touched_indices.push_back(first_update[k].first);
+            continue;
+        }
+        source.first_update = updates.size();
+        updates.insert(
+            updates.end(), first_update, first_update + source.n_updates);
+        update_srces.push_back(source);
+    }
+    std::sort(touched_indices.begin(), touched_indices.end());
+    touched_indices.erase(
+        std::unique(touched_indices.begin(), touched_indices.end()),
+        touched_indices.end());
+    std::stable_sort(
+        update_srces.begin(), update_srces.end(), update_source_compare_t());
+    update_srces.erase(
+        std::unique(
+            update_srces.begin(), update_srces.end(), update_source_equal_t()),
+        update_srces.end());
+    std::vector< cell_update_t >& update_dests = cache.update_dests;
+    BOOST_FOREACH( update_source_t const & source, update_srces ) {
+        update_dests.insert(
+            update_dests.end(),
+            updates.begin() + source.first_update,
+            updates.begin() + source.first_update + source.n_updates);
+    }
+    update_srces.clear();
+    updates.clear();
+
+    // Apply updates to the touched cells; the others end up as in
+    // next_frame.world.
+    std::vector< char >& touched_cells = cache.touched_cells;
+    touched_cells.resize(touched_indices.size());
+    for(std::size_t k = 0; k != touched_indices.size(); ++k)
+        touched_cells[k] = window[touched_indices[k]];
+    result.robot_is_destroyed = false;
+    BOOST_FOREACH( cell_update_t const update, update_dests ) {
+        index_t const index = update.first;
+        char const cell = update.second;
+        std::vector< index_t >::const_iterator const it = std::lower_bound(
+            touched_indices.begin(), touched_indices.end(), index);
+        if(it != touched_indices.end() && *it == index)
+            touched_cells[it - touched_indices.begin()] = cell;
+        if(index + 'D' == result.robot_index) {
+            assert(cell != '@');
+            result.robot_is_destroyed = cell == '*' || cell == '\\';
+        }
+    }
+    update_dests.clear();
+    arena_t* const arena = result.cell_map.get_arena();
+    result.cell_map = next_frame.world.cell_map;
+    result.cell_map.set_arena(arena);
+    result.cells_hash = next_frame.world.cells_hash;
+    std::vector< index_t >& result_deviations = cache.result_deviations;
+    for(std::size_t k = 0; k != touched_indices.size(); ++k) {
+        index_t const index = touched_indices[k];
+        if(next_frame.world[index] == touched_cells[k])
+            continue;
+        result[index] = touched_cells[k];
+        result_deviations.push_back(index);
     }
 
+    // Determine new set of active cells.
+    delta_t const & result_ = result;
+    std::vector< index_t >& result_active_indices = cache.active_indices;
+    BOOST_FOREACH( index_t const index, next_frame.world.active_indices )
+        if(!is_near(index, result_deviations, 1))
+            result_active_indices.push_back(index);
+    BOOST_FOREACH( index_t const index, result_deviations ) {
+        for(std::size_t i = index.i()-1; i != index.i()+2; ++i) {
+            for(std::size_t j = index.j()-1; j != index.j()+2; ++j) {
+                index_t const adj_index(i,j);
+                if(cell_is_active(result_, adj_index))
+                    result_active_indices.push_back(adj_index);
+            }
+        }
+    }
+    result_deviations.clear();
+    std::sort(
+        result_active_indices.begin(), result_active_indices.end(),
+        update_compare_t());
+    result.active_indices.assign(
+        result_active_indices.begin(),
+        std::unique(result_active_indices.begin(), result_active_indices.end()));
+    result_active_indices.clear();
+
+    check_conditions< Features >(result);
+}
+
+// The state move leads to from state, before the world update.
+delta_t moved_copy(delta_t const & state, char const move, arena_t* const arena)
+{
+    delta_t result(state.base,0);
+    result.cell_map = state.cell_map;
+    result.cell_map.set_arena(arena);
+    result.cells_hash = state.cells_hash;
+    result.robot_index = state.robot_index + move;
+    result.n_turns = state.n_turns + 1;
+    result.n_lambdas_remaining = state.n_lambdas_remaining;
+    result.n_turns_underwater = state.n_turns_underwater;
+    result.n_razors = state.n_razors;
     return result;
 }
 
+} // namespace
+
+/*******************************************************************************
+ * delta_t::move_robot_update_< Features >(
+ *     char const move,
+ *     arena_t* const arena)
+ *     -> delta_t
+ ******************************************************************************/
+
+template< class Features >
+delta_t
+delta_t::
+move_robot_update_(char const move, arena_t* const arena) const
+{
+    delta_t result = moved_copy(*this, move, arena);
+    sibling_cache_t cache(*this);
+    bool const rock_is_moved = move_robot< Features >(
+        *this, move, result, cache.changed_indices, cache.new_empty_indices);
+    update_world< Features >(*this, move, result, rock_is_moved, cache);
+    return result;
+}
+
+/*******************************************************************************
+ * delta_t::move_robot_update(char const move, arena_t* const arena) -> delta_t
+ ******************************************************************************/
+
+struct delta_t::move_robot_update_one_t
+{
+    delta_t const & state;
+    char move;
+    arena_t* arena;
+
+    move_robot_update_one_t(
+        delta_t const & state_,
+        char const move_,
+        arena_t* const arena_)
+        : state(state_), move(move_), arena(arena_)
+    { }
+
+    typedef delta_t result_type;
+
+    template< class Features >
+    delta_t apply() const
+    { return state.move_robot_update_< Features >(move, arena); }
+};
+
+delta_t
+delta_t::
+move_robot_update(char const move, arena_t* const arena) const
+{
+    assert(!robot_is_destroyed);
+    assert(move_is_valid(move));
+    return dispatch_features(
+        base.features, move_robot_update_one_t(*this, move, arena));
+}
+
+/*******************************************************************************
+ * delta_t::move_robot_update_< Features >(
+ *     char const * const moves,
+ *     std::size_t const n_moves,
+ *     boost::optional< delta_t >* const results,
+ *     arena_t* const arena,
+ *     world_timeline_t const * const timeline,
+ *     bool const simplify,
+ *     bool const always_follow_timeline)
+ *     -> void
+ ******************************************************************************/
+
+template< class Features >
+void
+delta_t::
+move_robot_update_(
+    char const * const moves,
+    std::size_t const n_moves,
+    boost::optional< delta_t >* const results,
+    arena_t* const arena,
+    world_timeline_t const * const timeline,
+    bool const simplify,
+    bool const always_follow_timeline) const
+{
+    sibling_cache_t cache(*this);
+
+    // The timeline is only worth following while the world changes more from
+    // one turn to the next than this state differs from it.
+    world_timeline_t::frame_t const * const frame =
+        timeline ? timeline->frame(n_turns) : 0;
+    world_timeline_t::frame_t const * next_frame =
+        frame ? timeline->frame(n_turns + 1) : 0;
+    if(next_frame) {
+        assert(&frame->world.base == &base);
+        cell_map.for_each_difference(
+            frame->world.cell_map, push_index_t(base.n_cols, cache.deviations));
+        if(!always_follow_timeline
+        && cache.deviations.size() >= frame->updates.size())
+            next_frame = 0;
+    }
+
+    // Every move updates the world of the same turn, and a move which changes
+    // no cells (as waiting does) leaves each active cell as it is here.
+    if(!next_frame) {
+        bool const grow_beards = beards_grow< Features >(base, n_turns + 1);
+        cache.sources.reserve(active_indices.size());
+        BOOST_FOREACH( index_t const index, active_indices )
+            cache.sources.push_back(classify_source< Features >(
+                cache.window, index, grow_beards, cache.updates));
+    }
+
+    for(std::size_t i = 0; i != n_moves; ++i) {
+        results[i] = boost::none;
+        char const move = moves[i];
+        if(!move_is_valid(move))
+            continue;
+        results[i] = moved_copy(*this, move, arena);
+        delta_t& result = *results[i];
+        bool const rock_is_moved = move_robot< Features >(
+            *this, move, result,
+            cache.changed_indices, cache.new_empty_indices);
+        if(next_frame)
+            update_world< Features >(
+                *this, move, result, rock_is_moved,
+                *frame, *next_frame, cache);
+        else
+            update_world< Features >(
+                *this, move, result, rock_is_moved, cache);
+        // Where the timeline is followed, a result differs from the frame of
+        // its turn about as little as this state does from the frame of this
+        // turn, and so less than from this state.
+        if(simplify && !result.robot_is_destroyed)
+            result.simplify_ip(next_frame ? next_frame->world : *this);
+        cache.changed_indices.clear();
+        cache.new_empty_indices.clear();
+    }
+}
+
+/*******************************************************************************
+ * delta_t::move_robot_update(
+ *     char const * const moves,
+ *     std::size_t const n_moves,
+ *     boost::optional< delta_t >* const results,
+ *     arena_t* const arena,
+ *     world_timeline_t const * const timeline,
+ *     bool const simplify,
+ *     bool const always_follow_timeline)
+ *     -> void
+ ******************************************************************************/
+
+struct delta_t::move_robot_update_batch_t
+{
+    delta_t const & state;
+    char const * moves;
+    std::size_t n_moves;
+    boost::optional< delta_t >* results;
+    arena_t* arena;
+    world_timeline_t const * timeline;
+    bool simplify;
+    bool always_follow_timeline;
+
+    move_robot_update_batch_t(
+        delta_t const & state_,
+        char const * const moves_,
+        std::size_t const n_moves_,
+        boost::optional< delta_t >* const results_,
+        arena_t* const arena_,
+        world_timeline_t const * const timeline_,
+        bool const simplify_,
+        bool const always_follow_timeline_)
+        : state(state_),
+          moves(moves_),
+          n_moves(n_moves_),
+          results(results_),
+          arena(arena_),
+          timeline(timeline_),
+          simplify(simplify_),
+          always_follow_timeline(always_follow_timeline_)
+    { }
+
+    typedef void result_type;
+
+    template< class Features >
+    void apply() const
+    {
+        state.move_robot_update_< Features >(
+            moves, n_moves, results, arena, timeline, simplify,
+            always_follow_timeline);
+    }
+};
+
+void
+delta_t::
+move_robot_update(
+    char const * const moves,
+    std::size_t const n_moves,
+    boost::optional< delta_t >* const results,
+    arena_t* const arena,
+    world_timeline_t const * const timeline /*= 0*/,
+    bool const simplify /*= false*/,
+    bool const always_follow_timeline /*= false*/) const
+{
+    assert(!robot_is_destroyed);
+    dispatch_features(
+        base.features,
+        move_robot_update_batch_t(
+            *this, moves, n_moves, results, arena, timeline, simplify,
+            always_follow_timeline));
+}
+
+/*******************************************************************************
+ * delta_t::simplify_ip(delta_t const & simplified) -> void
+ ******************************************************************************/
+
+namespace
+{
+
+struct push_change_t
+{
+    delta_t const & other;
+    std::vector< std::pair< index_t, char > >& changes;
+    push_change_t(
+        delta_t const & other_,
+        std::vector< std::pair< index_t, char > >& changes_)
+        : other(other_), changes(changes_)
+    { }
+    void operator()(std::size_t const offset) const
+    {
+        std::size_t const n_cols = other.base.n_cols;
+        index_t const index(offset / n_cols, offset % n_cols);
+        changes.push_back(std::make_pair(index, other[index]));
+    }
+};
+
+struct assign_index_t
+{
+    delta_t& state;
+    explicit assign_index_t(delta_t& state_)
+        : state(state_)
+    { }
+    void operator()(index_t const index, char const cell) const
+    { state[index] = cell; }
+};
+
+} // namespace
+
+void
+delta_t::
+simplify_ip(delta_t const & simplified)
+{
+    assert(&base == &simplified.base);
+    std::vector< std::pair< index_t, char > > changes;
+    cell_map.for_each_difference(
+        simplified.cell_map, push_change_t(simplified, changes));
+    icfp2012::simplify_ip(
+        *this, changes, base.n_beards == 0,
+        assign_index_t(*this));
+}
+
 /*******************************************************************************
  * delta_t::apply() -> state_t
  ******************************************************************************/
 
+namespace
+{
+
+struct assign_cell_t
+{
+    std::vector< char >& cells;
+    explicit assign_cell_t(std::vector< char >& cells_)
+        : cells(cells_)
+    { }
+    void operator()(std::size_t const offset, char const cell) const
+    { cells[offset] = cell; }
+};
+
+} // namespace
+
 state_t
 delta_t::
 apply() const
@@ -256,10 +870,9 @@ apply() const
     state_t result;
 
     result.cells = base.cells;
-    result.n_cells = base.n_cells;
-    typedef std::pair< index_t, char > index_cell_type;
-    BOOST_FOREACH( index_cell_type const index_cell, cell_map )
-        result[index_cell.first] = index_cell.second;
+    result.n_rows = base.n_rows;
+    result.n_cols = base.n_cols;
+    cell_map.for_each(assign_cell_t(result.cells));
 
     result.robot_index = robot_index;
     result.lift_index = base.lift_index;
@@ -279,9 +892,12 @@ apply() const
 
     result.beard_growth_rate = base.beard_growth_rate;
     result.n_razors = n_razors;
+    result.n_beards = static_cast< unsigned int >(
+        std::count(result.cells.begin(), result.cells.end(), 'W'));
+    result.features = base.features;
 
     result.trampoline_map = base.trampoline_map;
-    for(std::size_t i = 0; i != 8; ++i) {
+    for(std::size_t i = 0; i != 9; ++i) {
         result.target_map.trampolines[i].reserve(
             base.target_map.trampolines[i].size());
         BOOST_FOREACH(
@@ -289,7 +905,7 @@ apply() const
             base.target_map.trampolines[i] ) {
             char const trampoline_cell = result[trampoline_index];
             if('A' <= trampoline_cell && trampoline_cell <= 'I')
-                result.target_map.trampolines[i].push_back(trampoline_cell);
+                result.target_map.trampolines[i].push_back(trampoline_index);
         }
     }
 
@@ -13,27 +13,34 @@
 #include <cstddef>
 
 #include <algorithm>
-#include <deque>
-#include <map>
-#include <utility>
 
-#include <boost/functional/hash.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/optional.hpp>
 
+#include "active_set_t.hpp"
+#include "arena_t.hpp"
+#include "cell_map_t.hpp"
 #include "index_t.hpp"
 #include "move_is_valid.hpp"
 #include "state_t.hpp"
+#include "zobrist_key.hpp"
 
 namespace icfp2012
 {
 
+class world_timeline_t;
+
 struct delta_t
 {
     state_t const & base;
 
-    std::map< index_t, char > cell_map;
+    cell_map_t cell_map;
+    // XOR of zobrist_key(offset, cell) ^ zobrist_key(offset, base cell) over
+    // the cells in cell_map, maintained by operator[].
+    boost::uint64_t cells_hash;
 
     index_t robot_index;
-    std::deque< index_t > active_indices;
+    active_set_t active_indices;
 
     unsigned int n_turns;
     unsigned int n_lambdas_remaining;
@@ -48,7 +55,12 @@ struct delta_t
     void swap(delta_t& other);
 
     int score() const;
+    // An upper bound on the score of any continuation of this state.
+    int max_score() const;
     unsigned int water_level() const;
+    // The water level on turn n_turns_ of this game, which must be no earlier
+    // than the turn of base.
+    unsigned int water_level(unsigned int const n_turns_) const;
 
 private:
     class bracket_proxy;
@@ -59,6 +71,34 @@ public:
     bool move_is_valid(char const move) const;
 
     delta_t move_robot_update(char const move) const;
+    // As above, but the new nodes of the result's overlay (and of its copies)
+    // are allocated from arena rather than from this overlay's arena.
+    delta_t move_robot_update(char const move, arena_t* const arena) const;
+    // Sets results[i] to move_robot_update(moves[i], arena) for each valid
+    // move, and to none for the others.  The part of the world update which
+    // does not depend on the robot is computed once for all of the moves, or,
+    // given a timeline of this game (see world_timeline_t), mostly taken from
+    // it.  If simplify, the results in which the robot survives are
+    // simplified too (see simplify_ip), from the timeline's frame where it is
+    // followed, in which case this state and the frames must be simplified.
+    // The timeline is only followed where that looks cheaper, unless
+    // always_follow_timeline, which makes the timeline path checkable.
+    // Without a timeline, this saves little over a move_robot_update per move
+    // (up to ~15% on the sample maps), since copying the overlay dominates.
+    void move_robot_update(
+        char const * const moves,
+        std::size_t const n_moves,
+        boost::optional< delta_t >* const results,
+        arena_t* const arena,
+        world_timeline_t const * const timeline = 0,
+        bool const simplify = false,
+        bool const always_follow_timeline = false) const;
+
+    // As state_t::simplify_ip(), but only around the cells at which this
+    // state differs from simplified, a simplified state over the same base
+    // (such as the state this one was updated from).  Earth is only
+    // simplified if base has no beards.
+    void simplify_ip(delta_t const & simplified);
 
     state_t apply() const;
 
@@ -68,10 +108,33 @@ public:
     bool operator==(delta_t const & other) const;
     bool operator!=(delta_t const & other) const;
 
+    // partial_hash() covers the fields partial_equal compares and full_hash()
+    // those operator== compares.
+    boost::uint64_t partial_hash() const;
+    boost::uint64_t full_hash() const;
+
     std::size_t hash_value() const;
     inline friend std::size_t
     hash_value(delta_t const & this_)
     { return this_.hash_value(); }
+
+private:
+    struct move_robot_update_one_t;
+    struct move_robot_update_batch_t;
+
+    // As the move_robot_update's above, for a base with the features of
+    // Features (see state_t::features).
+    template< class Features >
+    delta_t move_robot_update_(char const move, arena_t* const arena) const;
+    template< class Features >
+    void move_robot_update_(
+        char const * const moves,
+        std::size_t const n_moves,
+        boost::optional< delta_t >* const results,
+        arena_t* const arena,
+        world_timeline_t const * const timeline,
+        bool const simplify,
+        bool const always_follow_timeline) const;
 };
 
 /*******************************************************************************
@@ -93,17 +156,18 @@ public:
     bracket_proxy const &
     operator=(char const cell) const
     {
-        std::map< index_t, char >::iterator iter =
-            this_.cell_map.lower_bound(index);
-        if(iter != this_.cell_map.end() && iter->first == index) {
-            if(this_.base[index] == cell)
-                this_.cell_map.erase(iter);
-            else
-                iter->second = cell;
-        }
-        else if(this_.base[index] != cell) {
-            this_.cell_map.insert(iter, std::make_pair(index, cell));
-        }
+        std::size_t const offset = this_.base.offset(index);
+        char const base_cell = this_.base.cells[offset];
+        char const old_cell = this_.cell_map.find(offset);
+        if(old_cell == cell)
+            return *this;
+        this_.cells_hash ^=
+            zobrist_key(offset, old_cell != 0 ? old_cell : base_cell)
+          ^ zobrist_key(offset, cell);
+        if(base_cell == cell)
+            this_.cell_map.erase(offset);
+        else
+            this_.cell_map.assign(offset, cell);
         return *this;
     }
 };
@@ -114,7 +178,9 @@ public:
 inline
 delta_t::
 delta_t(state_t const & base_, int)
-    : base(base_)
+    : base(base_),
+      cell_map(base_.cells.size()),
+      cells_hash(0)
 { }
 
 inline delta_t&
@@ -132,6 +198,7 @@ swap(delta_t& other)
     using std::swap;
 #define swap_( x ) swap(x, other.x)
     swap_(cell_map);
+    swap_(cells_hash);
     swap_(robot_index);
     swap_(active_indices);
     swap_(n_turns);
@@ -155,15 +222,36 @@ score() const
          - static_cast< int >(n_turns);
 }
 
+inline int
+delta_t::
+max_score() const
+{
+    if(robot_index == base.lift_index || robot_is_destroyed)
+        return score();
+    // Each remaining lambda takes at least one more move to collect, and
+    // entering the lift at least one more after that.
+    int const n_lambdas = static_cast< int >(
+        base.n_lambdas_collected + base.n_lambdas_remaining);
+    int const n_moves =
+        static_cast< int >(n_turns) + static_cast< int >(n_lambdas_remaining);
+    return std::max(75 * n_lambdas - n_moves - 1, 50 * n_lambdas - n_moves);
+}
+
 inline unsigned int
 delta_t::
 water_level() const
+{ return water_level(n_turns); }
+
+inline unsigned int
+delta_t::
+water_level(unsigned int const n_turns_) const
 {
+    assert(n_turns_ >= base.n_turns);
     if(base.flooding_rate == 0)
         return base.water_level;
     unsigned int const orig_water_level =
         base.water_level + base.n_turns / base.flooding_rate;
-    unsigned int const delta_water_level = n_turns / base.flooding_rate;
+    unsigned int const delta_water_level = n_turns_ / base.flooding_rate;
     return orig_water_level > delta_water_level ?
            orig_water_level - delta_water_level : 0;
 }
@@ -177,8 +265,9 @@ inline char
 delta_t::
 operator[](index_t const index) const
 {
-    std::map< index_t, char >::const_iterator iter = cell_map.find(index);
-    return iter != cell_map.end() ? iter->second : base[index];
+    std::size_t const offset = base.offset(index);
+    char const cell = cell_map.find(offset);
+    return cell != 0 ? cell : base.cells[offset];
 }
 
 inline bool
@@ -186,11 +275,17 @@ delta_t::
 move_is_valid(char const move) const
 { return icfp2012::move_is_valid(*this, move); }
 
+inline delta_t
+delta_t::
+move_robot_update(char const move) const
+{ return move_robot_update(move, cell_map.get_arena()); }
+
 inline bool
 delta_t::
 partial_equal(delta_t const & other) const
 {
     return robot_index == other.robot_index
+        && cells_hash == other.cells_hash
         && cell_map == other.cell_map;
 }
 
@@ -214,6 +309,7 @@ operator==(delta_t const & other) const
         && robot_is_destroyed == other.robot_is_destroyed
         && n_turns_underwater == other.n_turns_underwater
         && n_razors == other.n_razors
+        && cells_hash == other.cells_hash
         && cell_map == other.cell_map;
 }
 
@@ -222,10 +318,26 @@ delta_t::
 operator!=(delta_t const & other) const
 { return !operator==(other); }
 
+inline boost::uint64_t
+delta_t::
+partial_hash() const
+{ return cells_hash ^ zobrist_mix(robot_index.hash_value()); }
+
+inline boost::uint64_t
+delta_t::
+full_hash() const
+{
+    boost::uint64_t counters = n_lambdas_remaining;
+    counters = counters << 16 ^ n_turns_underwater;
+    counters = counters << 16 ^ n_razors;
+    counters = counters << 1 ^ static_cast< unsigned int >(robot_is_destroyed);
+    return partial_hash() ^ zobrist_mix(~counters);
+}
+
 inline std::size_t
 delta_t::
 hash_value() const
-{ return boost::hash_range(cell_map.begin(), cell_map.end()); }
+{ return static_cast< std::size_t >(full_hash()); }
 
 } // namespace icfp2012
 
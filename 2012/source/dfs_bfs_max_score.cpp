@@ -14,13 +14,20 @@
 #include <vector>
 
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
 
+#include "anytime_t.hpp"
+#include "arena_t.hpp"
 #include "bfs.hpp"
 #include "delta_t.hpp"
 #include "dfs_bfs_max_score.hpp"
 #include "state_t.hpp"
+#include "thread_pool_t.hpp"
 #include "visited_state_t.hpp"
 #include "visitor_result_e.hpp"
+#include "world_timeline_t.hpp"
 
 namespace icfp2012
 {
@@ -28,25 +35,105 @@ namespace icfp2012
 namespace
 {
 
+// The best score of any complete route found so far, shared between the
+// branches of a search.  Scores are absolute (turns are counted from the
+// start of the game), so a route found in any branch bounds every other.
+class best_score_t
+{
+public:
+    best_score_t()
+        : score(0)
+    { }
+
+    int get()
+    {
+        boost::lock_guard< boost::mutex > lock(mutex);
+        return score;
+    }
+
+    void update(int const score_)
+    {
+        boost::lock_guard< boost::mutex > lock(mutex);
+        score = std::max(score, score_);
+    }
+
+private:
+    boost::mutex mutex;
+    int score;
+};
+
+// A snapshot which the states of a search are overlaid on.  It is shared with
+// the branches below that search which are not rebased, and is freed once the
+// last of them is done.
+typedef boost::shared_ptr< state_t const > base_ptr_type;
+
+void dfs_bfs_max_score_(
+    base_ptr_type const & base,
+    delta_t const & start,
+    std::deque< char >& path,
+    std::size_t const max_visited_states,
+    std::size_t const max_branches,
+    thread_pool_t* const pool,
+    best_score_t& best_score,
+    anytime_t* const anytime,
+    std::deque< char > const & prefix);
+
+// The start of a branch stays overlaid on the base of the search it branches
+// from while it differs from that base in fewer than max_overlay_n_cells
+// cells.  Past that, it is applied to a snapshot of its own, which the
+// branches below it in turn share.  No overlay thus grows by more than
+// max_overlay_n_cells plus one search's worth of changes, however deep the
+// nesting goes, while the O(map) cost of a rebase is only paid once a
+// branch's overlay has grown.
+std::size_t const max_overlay_n_cells = 64;
+
+// The score of the route path from state.
+int route_score(delta_t state, std::deque< char > const & path)
+{
+    state.cell_map.set_arena(0);
+    BOOST_FOREACH( char const move, path )
+        state = state.move_robot_update(move);
+    return state.score();
+}
+
 struct visitor_t
 {
     typedef visited_state_t<> visited_state_type;
 
+    // Held here so that the base outlives every state of the search.
+    base_ptr_type const base;
     std::deque< char >& path;
     std::size_t const max_visited_states;
     std::size_t const max_branches;
+    thread_pool_t* const pool;
+    best_score_t& best_score;
+    anytime_t* const anytime;
+    // The route from the start of the whole search to the start of this one,
+    // so that anytime is offered complete routes.
+    std::deque< char > const & prefix;
 
     int base_score;
+    int base_max_score;
     std::size_t n_visited_states;
     std::vector< visited_state_type const * > visited_with_max_scores;
 
     visitor_t(
+        base_ptr_type const & base_,
         std::deque< char >& path_,
         std::size_t const max_visited_states_,
-        std::size_t const max_branches_)
-        : path(path_),
+        std::size_t const max_branches_,
+        thread_pool_t* const pool_,
+        best_score_t& best_score_,
+        anytime_t* const anytime_,
+        std::deque< char > const & prefix_)
+        : base(base_),
+          path(path_),
           max_visited_states(max_visited_states_),
           max_branches(max_branches_),
+          pool(pool_),
+          best_score(best_score_),
+          anytime(anytime_),
+          prefix(prefix_),
           n_visited_states(0)
     { visited_with_max_scores.reserve(max_branches); }
 
@@ -59,6 +146,75 @@ private:
             visited_state_type const * p1) const
         { return p1->state.score() < p0->state.score(); }
     };
+
+    // Explores the branch from visited_with_max_scores[k] into paths[k] and
+    // scores[k], unless it cannot beat the best score found so far.
+    struct branch_t
+    {
+        visitor_t const & this_;
+        std::vector< std::deque< char > >& paths;
+        std::vector< int >& scores;
+
+        branch_t(
+            visitor_t const & _this_,
+            std::vector< std::deque< char > >& paths_,
+            std::vector< int >& scores_)
+            : this_(_this_),
+              paths(paths_),
+              scores(scores_)
+        { }
+
+        typedef void result_type;
+
+        void operator()(std::size_t const k, std::size_t) const
+        {
+            visited_state_type const & q = *this_.visited_with_max_scores[k];
+            if(q.state.robot_index != q.state.base.lift_index
+            && (q.state.max_score() < this_.best_score.get()
+             || (this_.anytime && this_.anytime->is_expired()))) {
+                scores[k] = 0;
+                return;
+            }
+            std::deque< char > prefix1;
+            if(this_.anytime) {
+                for(visited_state_type const * p = &q; p->parent; p = p->parent)
+                    prefix1.push_front(p->move);
+                prefix1.insert(
+                    prefix1.begin(), this_.prefix.begin(), this_.prefix.end());
+            }
+            if(q.state.robot_index == q.state.base.lift_index) {
+                scores[k] = q.state.score();
+            }
+            else if(q.state.cell_map.size() < max_overlay_n_cells) {
+                // q.state is simplified, as is every state of the search.  Its
+                // overlay is shared with this search, whose arena is not
+                // thread-safe, so the branch's own nodes come from the heap.
+                delta_t start1(q.state);
+                start1.cell_map.set_arena(0);
+                dfs_bfs_max_score_(
+                    this_.base, start1, paths[k],
+                    this_.max_visited_states, this_.max_branches,
+                    0, this_.best_score, this_.anytime, prefix1);
+                scores[k] = route_score(start1, paths[k]);
+            }
+            else {
+                boost::shared_ptr< state_t > base1(
+                    new state_t(q.state.apply()));
+                base1->simplify_ip();
+                delta_t const start1(*base1);
+                dfs_bfs_max_score_(
+                    base1, start1, paths[k],
+                    this_.max_visited_states, this_.max_branches,
+                    0, this_.best_score, this_.anytime, prefix1);
+                scores[k] = route_score(start1, paths[k]);
+            }
+            this_.best_score.update(scores[k]);
+            if(this_.anytime) {
+                prefix1.insert(prefix1.end(), paths[k].begin(), paths[k].end());
+                this_.anytime->offer(prefix1, scores[k]);
+            }
+        }
+    };
 public:
 
     typedef visitor_result_e result_type;
@@ -69,6 +225,7 @@ public:
 
         if(!visited.parent) {
             base_score = score;
+            base_max_score = visited.state.max_score();
             return visitor_result_e_continue;
         }
 
@@ -88,52 +245,97 @@ public:
         }
 
         if(++n_visited_states < max_visited_states
-        && visited.state.robot_index != visited.state.base.lift_index)
-            return visitor_result_e_continue;
+        && visited.state.robot_index != visited.state.base.lift_index) {
+            // Give up on this search once another branch has found a route
+            // scoring more than any route from here could, or once out of
+            // time.
+            if(n_visited_states % 1024 != 0
+            || (base_max_score >= best_score.get()
+             && !(anytime && anytime->is_expired())))
+                return visitor_result_e_continue;
+            visited_with_max_scores.clear();
+        }
 
         if(!visited_with_max_scores.empty()) {
+            std::size_t const n_branches = visited_with_max_scores.size();
+            std::vector< std::deque< char > > paths(n_branches);
+            std::vector< int > scores(n_branches);
+            branch_t const branch(*this, paths, scores);
+            if(pool)
+                pool->for_each_index(n_branches, branch);
+            else
+                for(std::size_t k = 0; k != n_branches; ++k)
+                    branch(k, 0);
+
             int max_score = 0;
             visited_state_type const * p = 0;
-            BOOST_FOREACH(
-                visited_state_type const * q,
-                visited_with_max_scores ) {
-                std::deque< char > path1;
-                if(q->state.robot_index == q->state.base.lift_index) {
-                    score = q->state.score();
-                }
-                else {
-                    state_t state1 = q->state.apply();
-                    state1.simplify_ip();
-                    dfs_bfs_max_score(
-                        delta_t(state1), path1,
-                        max_visited_states, max_branches);
-                    state1.move_robot_update_ip(path1);
-                    score = state1.score();
-                }
-                if(score > max_score) {
-                    max_score = score;
-                    p = q;
-                    path.swap(path1);
+            for(std::size_t k = 0; k != n_branches; ++k) {
+                if(scores[k] > max_score) {
+                    max_score = scores[k];
+                    p = visited_with_max_scores[k];
+                    path.swap(paths[k]);
                 }
             }
-            assert(p);
-            do {
-                assert(p->move);
-                path.push_front(p->move);
-            } while((p = p->parent)->parent);
+            // Every branch may have been pruned, in which case no route from
+            // here beats the best score (or there was no time to find one)
+            // and the path is left empty.
+            assert(p || best_score.get() > 0 || anytime);
+            if(p) {
+                do {
+                    assert(p->move);
+                    path.push_front(p->move);
+                } while((p = p->parent)->parent);
+            }
         }
 
         return visitor_result_e_return;
     }
 };
 
+void dfs_bfs_max_score_(
+    base_ptr_type const & base,
+    delta_t const & start,
+    std::deque< char >& path,
+    std::size_t const max_visited_states,
+    std::size_t const max_branches,
+    thread_pool_t* const pool,
+    best_score_t& best_score,
+    anytime_t* const anytime,
+    std::deque< char > const & prefix)
+{
+    assert(&start.base == base.get());
+    // start is simplified, and so is every state searched from it.  Its
+    // overlay outlives the timeline, which is built afresh for each search as
+    // frames must share the base of the states which follow them.
+    world_timeline_t const timeline(start, true);
+    arena_t arena;
+    bfs< void >(
+        start,
+        visitor_t(
+            base, path, max_visited_states, max_branches, pool, best_score,
+            anytime, prefix),
+        arena, bfs_default_max_table_bytes, &timeline, true);
+}
+
 } // namespace
 
 void dfs_bfs_max_score(
     delta_t const & start,
     std::deque< char >& path,
     std::size_t const max_visited_states,
-    std::size_t const max_branches)
-{ bfs(start, visitor_t(path, max_visited_states, max_branches)); }
+    std::size_t const max_branches,
+    std::size_t const n_threads /*= 1*/,
+    anytime_t* const anytime /*= 0*/)
+{
+    thread_pool_t pool(n_threads);
+    best_score_t best_score;
+    boost::shared_ptr< state_t > simplified_base(new state_t(start.apply()));
+    simplified_base->simplify_ip();
+    dfs_bfs_max_score_(
+        simplified_base, delta_t(*simplified_base),
+        path, max_visited_states, max_branches,
+        pool.size() != 1 ? &pool : 0, best_score,
+        anytime, std::deque< char >());
+}
 
 } // namespace icfp2012
@@ -13,16 +13,21 @@
 
 #include <deque>
 
+#include "anytime_t.hpp"
 #include "delta_t.hpp"
 
 namespace icfp2012
 {
 
+// Searches on n_threads threads, or on one per hardware thread if n_threads is
+// 0 (see thread_pool_t).
 void dfs_bfs_max_score(
     delta_t const & start,
     std::deque< char >& path,
     std::size_t const max_visited_states,
-    std::size_t const max_branches);
+    std::size_t const max_branches,
+    std::size_t const n_threads = 1,
+    anytime_t* const anytime = 0);
 
 } // namespace icfp2012
 
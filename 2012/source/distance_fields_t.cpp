@@ -0,0 +1,543 @@
+/*******************************************************************************
+ * icfp/2012/source/distance_fields_t.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <boost/foreach.hpp>
+
+#include "distance_fields_t.hpp"
+#include "index_t.hpp"
+#include "state_t.hpp"
+
+namespace icfp2012
+{
+
+namespace
+{
+
+struct compare_distances
+{
+    std::vector< distance_fields_t::distance_type > const & field;
+
+    explicit compare_distances(
+        std::vector< distance_fields_t::distance_type > const & field_)
+        : field(field_)
+    { }
+
+    typedef bool result_type;
+    bool operator()(std::size_t const offset0, std::size_t const offset1) const
+    { return field[offset0] < field[offset1]; }
+};
+
+} // namespace
+
+distance_fields_t::distance_type const distance_fields_t::infinity;
+
+/*******************************************************************************
+ * distance_fields_t::distance_fields_t(state_t const & state)
+ ******************************************************************************/
+
+distance_fields_t::
+distance_fields_t(state_t const & state)
+    : n_cols(state.n_cols),
+      passable(state.cells.size()),
+      jumps(state.cells.size()),
+      landings(state.cells.size()),
+      affected(state.cells.size(), false)
+{
+    std::vector< std::size_t > sources;
+    for(std::size_t offset = 0; offset != state.cells.size(); ++offset) {
+        char const cell = state.cells[offset];
+        passable[offset] = is_passable(cell);
+        if('A' <= cell && cell <= 'I') {
+            std::size_t const target = state.offset(state.trampoline_map[cell]);
+            trampolines[offset] = target;
+            std::size_t const neighbors[] = {
+                offset - 1, offset + 1, offset - n_cols, offset + n_cols };
+            BOOST_FOREACH( std::size_t const neighbor, neighbors ) {
+                jumps[neighbor].push_back(target);
+                landings[target].push_back(neighbor);
+            }
+        }
+    }
+
+    sources.push_back(state.offset(state.lift_index));
+    compute(lift_field, sources);
+    for(std::size_t offset = 0; offset != state.cells.size(); ++offset) {
+        if(state.cells[offset] != '\\')
+            continue;
+        sources.assign(1, offset);
+        compute(lambda_fields[offset], sources);
+    }
+    update_nearest_lambda_field();
+}
+
+/*******************************************************************************
+ * distance_fields_t::update(state_t const & state) -> void
+ ******************************************************************************/
+
+void
+distance_fields_t::
+update(state_t const & state)
+{
+    assert(state.cells.size() == passable.size());
+    bool lambda_is_removed = false;
+    for(std::size_t offset = 0; offset != state.cells.size(); ++offset)
+        lambda_is_removed |= update_cell(state, offset);
+    if(lambda_is_removed)
+        update_nearest_lambda_field();
+}
+
+/*******************************************************************************
+ * distance_fields_t::update(
+ *     state_t const & state,
+ *     state_t::undo_t const & undo)
+ *     -> void
+ ******************************************************************************/
+
+void
+distance_fields_t::
+update(state_t const & state, state_t::undo_t const & undo)
+{
+    assert(state.cells.size() == passable.size());
+    typedef std::pair< std::size_t, char > offset_cell_type;
+    bool lambda_is_removed = false;
+    BOOST_FOREACH( offset_cell_type const offset_cell, undo.cells )
+        lambda_is_removed |= update_cell(state, offset_cell.first);
+    if(lambda_is_removed)
+        update_nearest_lambda_field();
+}
+
+/*******************************************************************************
+ * distance_fields_t::lift_distance(index_t const index) const
+ *     -> distance_type
+ ******************************************************************************/
+
+distance_fields_t::distance_type
+distance_fields_t::
+lift_distance(index_t const index) const
+{ return lift_field[index.i() * n_cols + index.j()]; }
+
+/*******************************************************************************
+ * distance_fields_t::lambda_distance(
+ *     index_t const lambda_index,
+ *     index_t const index) const
+ *     -> distance_type
+ ******************************************************************************/
+
+distance_fields_t::distance_type
+distance_fields_t::
+lambda_distance(index_t const lambda_index, index_t const index) const
+{
+    std::map< std::size_t, field_type >::const_iterator const it =
+        lambda_fields.find(lambda_index.i() * n_cols + lambda_index.j());
+    assert(it != lambda_fields.end());
+    return it->second[index.i() * n_cols + index.j()];
+}
+
+/*******************************************************************************
+ * distance_fields_t::nearest_lambda_distance(index_t const index) const
+ *     -> distance_type
+ ******************************************************************************/
+
+distance_fields_t::distance_type
+distance_fields_t::
+nearest_lambda_distance(index_t const index) const
+{ return nearest_lambda_field[index.i() * n_cols + index.j()]; }
+
+/*******************************************************************************
+ * distance_fields_t::neighbors(
+ *     std::size_t const offset,
+ *     std::vector< std::size_t >& result) const
+ *     -> void
+ ******************************************************************************/
+
+void
+distance_fields_t::
+neighbors(std::size_t const offset, std::vector< std::size_t >& result) const
+{
+    adjacent(offset, false, result);
+    std::size_t n = 0;
+    BOOST_FOREACH( std::size_t const neighbor, result )
+        if(passable[neighbor])
+            result[n++] = neighbor;
+    result.resize(n);
+}
+
+/*******************************************************************************
+ * distance_fields_t::is_passable(char const cell) -> bool
+ ******************************************************************************/
+
+bool
+distance_fields_t::
+is_passable(char const cell)
+{ return !(cell == '#' || cell == '+' || cell == 'L' || cell == 'O'); }
+
+/*******************************************************************************
+ * distance_fields_t::adjacent(
+ *     std::size_t const offset,
+ *     bool const reverse,
+ *     std::vector< std::size_t >& result) const
+ *     -> void
+ *
+ * The cells the robot may move to from offset or, if reverse, those from which
+ * it may move to offset, were they passable.
+ ******************************************************************************/
+
+void
+distance_fields_t::
+adjacent(
+    std::size_t const offset,
+    bool const reverse,
+    std::vector< std::size_t >& result) const
+{
+    result.clear();
+    result.push_back(offset - 1);
+    result.push_back(offset + 1);
+    result.push_back(offset - n_cols);
+    result.push_back(offset + n_cols);
+    std::vector< std::size_t > const & others =
+        reverse ? landings[offset] : jumps[offset];
+    result.insert(result.end(), others.begin(), others.end());
+}
+
+/*******************************************************************************
+ * distance_fields_t::successor_distance(
+ *     field_type const & field,
+ *     std::size_t const offset)
+ *     -> distance_type
+ *
+ * The distance from offset via the closest cell the robot may move to.
+ ******************************************************************************/
+
+distance_fields_t::distance_type
+distance_fields_t::
+successor_distance(field_type const & field, std::size_t const offset)
+{
+    distance_type result = infinity;
+    adjacent(offset, false, successors);
+    BOOST_FOREACH( std::size_t const successor, successors ) {
+        distance_type const distance = field[successor];
+        if(distance != infinity
+        && (passable[successor] || distance == 0))
+            result = std::min(result, distance + 1);
+    }
+    return result;
+}
+
+/*******************************************************************************
+ * distance_fields_t::compute(
+ *     field_type& field,
+ *     std::vector< std::size_t > const & sources)
+ *     -> void
+ ******************************************************************************/
+
+void
+distance_fields_t::
+compute(field_type& field, std::vector< std::size_t > const & sources)
+{
+    field.assign(passable.size(), infinity);
+    BOOST_FOREACH( std::size_t const source, sources ) {
+        field[source] = 0;
+        queue.push_back(source);
+    }
+    propagate(field);
+}
+
+/*******************************************************************************
+ * distance_fields_t::propagate(field_type& field) -> void
+ *
+ * Lowers the distances of the cells from which those in queue, which are in
+ * order of distance, may be reached, and so on.
+ ******************************************************************************/
+
+void
+distance_fields_t::
+propagate(field_type& field)
+{
+    for(std::size_t k = 0; k != queue.size(); ++k) {
+        distance_type const distance = field[queue[k]] + 1;
+        adjacent(queue[k], true, predecessors);
+        BOOST_FOREACH( std::size_t const predecessor, predecessors ) {
+            if(passable[predecessor] && distance < field[predecessor]) {
+                field[predecessor] = distance;
+                queue.push_back(predecessor);
+            }
+        }
+    }
+    queue.clear();
+}
+
+/*******************************************************************************
+ * distance_fields_t::unblock(field_type& field, std::size_t const offset)
+ *     -> void
+ *
+ * Updates field to offset having become passable, which can only lower
+ * distances.
+ ******************************************************************************/
+
+void
+distance_fields_t::
+unblock(field_type& field, std::size_t const offset)
+{
+    distance_type const distance = successor_distance(field, offset);
+    if(distance >= field[offset])
+        return;
+    field[offset] = distance;
+    queue.push_back(offset);
+    propagate(field);
+}
+
+/*******************************************************************************
+ * distance_fields_t::block(field_type& field, std::size_t const offset)
+ *     -> void
+ *
+ * Updates field to offset having become impassable, which can only raise
+ * distances.
+ ******************************************************************************/
+
+void
+distance_fields_t::
+block(field_type& field, std::size_t const offset)
+{
+    if(field[offset] == 0 || field[offset] == infinity)
+        return;
+    affected[offset] = true;
+    affected_offsets.push_back(offset);
+    raise(field);
+}
+
+/*******************************************************************************
+ * distance_fields_t::remove_trampoline(std::size_t const offset) -> void
+ *
+ * Removes the moves onto the trampoline at offset, which has been used (and so
+ * has every other trampoline with the same target), and updates the fields to
+ * their loss, which can only raise distances.
+ ******************************************************************************/
+
+void
+distance_fields_t::
+remove_trampoline(std::size_t const offset)
+{
+    std::map< std::size_t, std::size_t >::iterator const it =
+        trampolines.find(offset);
+    assert(it != trampolines.end());
+    std::size_t const target = it->second;
+    trampolines.erase(it);
+
+    std::size_t const neighbors[] = {
+        offset - 1, offset + 1, offset - n_cols, offset + n_cols };
+    BOOST_FOREACH( std::size_t const neighbor, neighbors ) {
+        std::vector< std::size_t >& jumps_ = jumps[neighbor];
+        jumps_.erase(std::find(jumps_.begin(), jumps_.end(), target));
+        std::vector< std::size_t >& landings_ = landings[target];
+        landings_.erase(
+            std::find(landings_.begin(), landings_.end(), neighbor));
+    }
+
+    raise_unsupported(lift_field, neighbors, 4);
+    typedef std::pair< std::size_t const, field_type > lambda_field_type;
+    BOOST_FOREACH( lambda_field_type& lambda_field, lambda_fields )
+        raise_unsupported(lambda_field.second, neighbors, 4);
+    raise_unsupported(nearest_lambda_field, neighbors, 4);
+}
+
+/*******************************************************************************
+ * distance_fields_t::raise_unsupported(
+ *     field_type& field,
+ *     std::size_t const * const offsets,
+ *     std::size_t const n_offsets)
+ *     -> void
+ *
+ * Updates field to some of the moves from offsets having been removed.
+ ******************************************************************************/
+
+void
+distance_fields_t::
+raise_unsupported(
+    field_type& field,
+    std::size_t const * const offsets,
+    std::size_t const n_offsets)
+{
+    for(std::size_t k = 0; k != n_offsets; ++k) {
+        std::size_t const offset = offsets[k];
+        if(affected[offset]
+        || !passable[offset]
+        || field[offset] == 0
+        || field[offset] == infinity
+        || successor_distance(field, offset) == field[offset])
+            continue;
+        affected[offset] = true;
+        affected_offsets.push_back(offset);
+    }
+    if(!affected_offsets.empty())
+        raise(field);
+}
+
+/*******************************************************************************
+ * distance_fields_t::raise(field_type& field) -> void
+ *
+ * Raises the distances of the cells in affected_offsets, which have lost every
+ * shortest route, and of the cells all of whose shortest routes pass through
+ * them.  Those are found in order of distance, as the cells with no successor
+ * one closer other than those already found, and are then given their new
+ * distances from the cells around them.
+ ******************************************************************************/
+
+void
+distance_fields_t::
+raise(field_type& field)
+{
+    // Visit the cells in order of distance, merging those initially affected
+    // with those found from them.
+    layer = affected_offsets;
+    std::sort(layer.begin(), layer.end(), compare_distances(field));
+    std::size_t i = 0;
+    std::size_t k = 0;
+    while(i != layer.size() || k != queue.size()) {
+        std::size_t const x =
+            k == queue.size()
+         || (i != layer.size() && field[layer[i]] <= field[queue[k]]) ?
+            layer[i++] : queue[k++];
+        adjacent(x, true, predecessors);
+        BOOST_FOREACH( std::size_t const u, predecessors ) {
+            if(affected[u]
+            || !passable[u]
+            || field[u] != field[x] + 1)
+                continue;
+            bool is_supported = false;
+            adjacent(u, false, successors);
+            BOOST_FOREACH( std::size_t const w, successors ) {
+                if(!affected[w]
+                && (passable[w] || field[w] == 0)
+                && field[w] + 1 == field[u]) {
+                    is_supported = true;
+                    break;
+                }
+            }
+            if(is_supported)
+                continue;
+            affected[u] = true;
+            affected_offsets.push_back(u);
+            queue.push_back(u);
+        }
+    }
+    layer.clear();
+    queue.clear();
+
+    BOOST_FOREACH( std::size_t const x, affected_offsets )
+        field[x] = infinity;
+    BOOST_FOREACH( std::size_t const x, affected_offsets ) {
+        affected[x] = false;
+        if(!passable[x])
+            continue;
+        distance_type const distance = successor_distance(field, x);
+        if(distance == infinity)
+            continue;
+        field[x] = distance;
+        layer.push_back(x);
+    }
+    affected_offsets.clear();
+
+    // Propagate from the reseeded cells, merging them in order of distance
+    // with the cells they lower.  A cell lowered after being reseeded is
+    // simply visited again.
+    std::sort(layer.begin(), layer.end(), compare_distances(field));
+    i = 0;
+    k = 0;
+    while(i != layer.size() || k != queue.size()) {
+        std::size_t const x =
+            k == queue.size()
+         || (i != layer.size() && field[layer[i]] <= field[queue[k]]) ?
+            layer[i++] : queue[k++];
+        distance_type const distance = field[x] + 1;
+        adjacent(x, true, predecessors);
+        BOOST_FOREACH( std::size_t const predecessor, predecessors ) {
+            if(passable[predecessor] && distance < field[predecessor]) {
+                field[predecessor] = distance;
+                queue.push_back(predecessor);
+            }
+        }
+    }
+    layer.clear();
+    queue.clear();
+}
+
+/*******************************************************************************
+ * distance_fields_t::update_cell(
+ *     state_t const & state,
+ *     std::size_t const offset)
+ *     -> bool
+ *
+ * Returns whether a lambda was removed, in which case the nearest lambda field
+ * must be recomputed.
+ ******************************************************************************/
+
+bool
+distance_fields_t::
+update_cell(state_t const & state, std::size_t const offset)
+{
+    char const cell = state.cells[offset];
+
+    if(!('A' <= cell && cell <= 'I') && trampolines.count(offset) != 0)
+        remove_trampoline(offset);
+
+    bool const is_passable_ = is_passable(cell);
+    if(is_passable_ != passable[offset]) {
+        passable[offset] = is_passable_;
+        void (distance_fields_t::*const f)(field_type&, std::size_t const) =
+            is_passable_ ?
+            &distance_fields_t::unblock :
+            &distance_fields_t::block;
+        (this->*f)(lift_field, offset);
+        typedef std::pair< std::size_t const, field_type > lambda_field_type;
+        BOOST_FOREACH( lambda_field_type& lambda_field, lambda_fields )
+            (this->*f)(lambda_field.second, offset);
+        (this->*f)(nearest_lambda_field, offset);
+    }
+
+    std::map< std::size_t, field_type >::iterator const it =
+        lambda_fields.find(offset);
+    if(cell == '\\') {
+        if(it == lambda_fields.end()) {
+            std::vector< std::size_t > const sources(1, offset);
+            compute(lambda_fields[offset], sources);
+            nearest_lambda_field[offset] = 0;
+            queue.push_back(offset);
+            propagate(nearest_lambda_field);
+        }
+    }
+    else if(it != lambda_fields.end()) {
+        lambda_fields.erase(it);
+        return true;
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * distance_fields_t::update_nearest_lambda_field() -> void
+ ******************************************************************************/
+
+void
+distance_fields_t::
+update_nearest_lambda_field()
+{
+    std::vector< std::size_t > sources;
+    typedef std::pair< std::size_t const, field_type > lambda_field_type;
+    BOOST_FOREACH( lambda_field_type const & lambda_field, lambda_fields )
+        sources.push_back(lambda_field.first);
+    compute(nearest_lambda_field, sources);
+}
+
+} // namespace icfp2012
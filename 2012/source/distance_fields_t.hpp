@@ -0,0 +1,118 @@
+/*******************************************************************************
+ * icfp/2012/source/distance_fields_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_DISTANCE_FIELDS_T_HPP
+#define ICFP_2012_SOURCE_DISTANCE_FIELDS_T_HPP
+
+#include <cstddef>
+
+#include <map>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "index_t.hpp"
+#include "state_t.hpp"
+
+namespace icfp2012
+{
+
+// The number of moves the robot needs to reach the lift, each lambda, and the
+// nearest lambda from each cell, ignoring everything which may change during
+// a game: rocks which may yet move, earth, beards, and the water.  Only walls,
+// the lift (which the robot can only enter), and unmovable rocks ('+', as
+// marked by state_t::simplify_ip) are obstacles, and trampolines both take
+// the robot to their targets, until they are used, and may be walked over.
+// The distances are thus lower bounds on the moves actually needed, in the
+// state the fields were computed from and in any later one, and are suitable
+// for pruning as well as for move ordering and heuristics.
+//
+// The fields are kept up to date by update as cells change, which only
+// revisits the cells whose distances change.
+class distance_fields_t
+{
+public:
+    typedef boost::uint32_t distance_type;
+    static distance_type const infinity = ~distance_type(0);
+
+    explicit distance_fields_t(state_t const & state);
+
+    // Updates the fields to state, in which any cell may have changed since
+    // the last update (e.g., after state_t::simplify_ip).
+    void update(state_t const & state);
+    // Updates the fields to state, in which only the cells recorded in undo
+    // have changed since the last update (i.e., after
+    // state_t::move_robot_update_ip(move, undo)).
+    void update(state_t const & state, state_t::undo_t const & undo);
+
+    distance_type lift_distance(index_t const index) const;
+    // lambda_index must be the index of a lambda remaining in the last state
+    // the fields were updated to.
+    distance_type lambda_distance(
+        index_t const lambda_index,
+        index_t const index) const;
+    distance_type nearest_lambda_distance(index_t const index) const;
+
+    // Sets result to the passable cells the robot may move to in one move from
+    // the cell at offset, directly or by a trampoline.
+    void neighbors(
+        std::size_t const offset,
+        std::vector< std::size_t >& result) const;
+
+private:
+    typedef std::vector< distance_type > field_type;
+
+    std::size_t const n_cols;
+    std::vector< bool > passable;
+    // trampolines maps the offset of each remaining trampoline to that of its
+    // target.  jumps[offset] holds the trampoline targets reachable in one
+    // move from offset, and landings[offset] the cells from which offset is.
+    std::map< std::size_t, std::size_t > trampolines;
+    std::vector< std::vector< std::size_t > > jumps;
+    std::vector< std::vector< std::size_t > > landings;
+
+    field_type lift_field;
+    std::map< std::size_t, field_type > lambda_fields;
+    field_type nearest_lambda_field;
+
+    // Reused from one call to the next.
+    std::vector< std::size_t > successors;
+    std::vector< std::size_t > predecessors;
+    std::vector< std::size_t > queue;
+    std::vector< bool > affected;
+    std::vector< std::size_t > affected_offsets;
+    std::vector< std::size_t > layer;
+
+    static bool is_passable(char const cell);
+
+    void adjacent(
+        std::size_t const offset,
+        bool const reverse,
+        std::vector< std::size_t >& result) const;
+    distance_type successor_distance(
+        field_type const & field,
+        std::size_t const offset);
+
+    void compute(field_type& field, std::vector< std::size_t > const & sources);
+    void propagate(field_type& field);
+    void unblock(field_type& field, std::size_t const offset);
+    void block(field_type& field, std::size_t const offset);
+    void remove_trampoline(std::size_t const offset);
+    void raise_unsupported(
+        field_type& field,
+        std::size_t const * const offsets,
+        std::size_t const n_offsets);
+    void raise(field_type& field);
+
+    bool update_cell(state_t const & state, std::size_t const offset);
+    void update_nearest_lambda_field();
+};
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_DISTANCE_FIELDS_T_HPP
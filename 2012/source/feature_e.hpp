@@ -0,0 +1,64 @@
+/*******************************************************************************
+ * icfp/2012/source/feature_e.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_FEATURE_E_HPP
+#define ICFP_2012_SOURCE_FEATURE_E_HPP
+
+#include <cassert>
+
+namespace icfp2012
+{
+
+// The extensions of the basic game (rocks, earth, lambdas and the lift) which
+// a map may use, as found by state_t::initialize.
+enum feature_e
+{
+    // Water, rising or not.
+    feature_e_water = 1,
+    // Beards and razors.
+    feature_e_beards = 2,
+    feature_e_trampolines = 4,
+    // Higher-order rocks ('@').
+    feature_e_lambda_rocks = 8,
+    n_feature_sets = 16
+};
+
+// The simulators are templated on a Features policy, so that the rules of the
+// extensions a map does not use compile away.
+template< unsigned int Features >
+struct features_t
+{
+    static bool const water = (Features & feature_e_water) != 0;
+    static bool const beards = (Features & feature_e_beards) != 0;
+    static bool const trampolines = (Features & feature_e_trampolines) != 0;
+    static bool const lambda_rocks = (Features & feature_e_lambda_rocks) != 0;
+};
+
+typedef features_t< n_feature_sets - 1 > all_features_t;
+
+// Returns f.template apply< features_t< features > >().
+template< class F >
+inline typename F::result_type
+dispatch_features(unsigned int const features, F const & f)
+{
+    switch(features) {
+#define case_( n ) case n: return f.template apply< features_t< n > >();
+    case_( 0 ) case_( 1 ) case_( 2 ) case_( 3 )
+    case_( 4 ) case_( 5 ) case_( 6 ) case_( 7 )
+    case_( 8 ) case_( 9 ) case_( 10 ) case_( 11 )
+    case_( 12 ) case_( 13 ) case_( 14 ) case_( 15 )
+#undef case_
+    default:
+        assert(false);
+        return f.template apply< all_features_t >();
+    }
+}
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_FEATURE_E_HPP
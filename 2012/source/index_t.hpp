@@ -9,91 +9,124 @@
 #ifndef ICFP_2012_SOURCE_INDEX_T_HPP
 #define ICFP_2012_SOURCE_INDEX_T_HPP
 
+#include <cassert>
 #include <cstddef>
 
 #include <iostream>
 
+#include <boost/cstdint.hpp>
 #include <boost/functional/hash.hpp>
 
 namespace icfp2012
 {
 
-struct index_t
+// The row i and column j of a cell, packed into a single 32-bit offset with a
+// row stride of 2^16 (so maps may be at most 65535 cells on a side).  Indices
+// thus order as (i,j) pairs do, and a step in any direction is a single add
+// of a constant delta.  The invalid index (the default) has all bits set.
+class index_t
 {
-    std::size_t i;
-    std::size_t j;
+public:
+    typedef boost::uint32_t value_type;
 
-    static int as_i(char const c)
-    { return (c == 'D') - (c == 'U'); }
-    static int as_j(char const c)
-    { return (c == 'R') - (c == 'L'); }
+    static unsigned int const stride_bits = 16;
+    static value_type const stride = value_type(1) << stride_bits;
 
-    index_t(std::size_t const i_ = -1, std::size_t const j_ = -1)
-        : i(i_), j(j_)
+    // The change in offset of a step in direction c, which is one of 'L', 'R',
+    // 'U', 'D' (or 'W', 'S' or 'A', which do not move).
+    static value_type delta(char const c);
+
+    index_t()
+        : value(-1)
     { }
 
+    index_t(std::size_t const i_, std::size_t const j_)
+        : value(static_cast< value_type >(i_ << stride_bits | j_))
+    { assert(i_ < stride && j_ < stride); }
+
+    std::size_t i() const
+    { return value >> stride_bits; }
+    std::size_t j() const
+    { return value & (stride - 1); }
+
     bool valid() const
-    { return i != -1 && j != -1; }
+    { return value != value_type(-1); }
 
-    void assign(std::size_t const i_ = -1, std::size_t const j_ = -1)
-    {
-        i = i_;
-        j = j_;
-    }
+    void assign()
+    { value = -1; }
+    void assign(std::size_t const i_, std::size_t const j_)
+    { *this = index_t(i_, j_); }
 
     bool operator==(index_t const & other) const
-    { return i == other.i && j == other.j; }
+    { return value == other.value; }
     bool operator!=(index_t const & other) const
-    { return !operator==(other); }
+    { return value != other.value; }
 
     bool operator<(index_t const & other) const
-    { return i < other.i || i == other.i && j < other.j; }
+    { return value < other.value; }
     bool operator>(index_t const & other) const
-    { return other < *this; }
+    { return value > other.value; }
 
     bool operator<=(index_t const & other) const
-    { return !(other < *this); }
+    { return value <= other.value; }
     bool operator>=(index_t const & other) const
-    { return !(*this < other); }
+    { return value >= other.value; }
 
     index_t& operator+=(char const c)
     {
-        i += as_i(c);
-        j += as_j(c);
+        value += delta(c);
         return *this;
     }
 
     index_t operator+(char const c) const
-    { return index_t(i + as_i(c), j + as_j(c)); }
+    { return index_t(*this) += c; }
     inline friend index_t
     operator+(char const c, index_t const & this_)
     { return this_ + c; }
 
     index_t& operator-=(char const c)
     {
-        i -= as_i(c);
-        j -= as_j(c);
+        value -= delta(c);
         return *this;
     }
 
     index_t operator-(char const c) const
-    { return index_t(i - as_i(c), j - as_j(c)); }
+    { return index_t(*this) -= c; }
 
     std::size_t hash_value() const
-    {
-        std::size_t result = boost::hash< std::size_t >()(i);
-        boost::hash_combine(result, j);
-        return result;
-    }
+    { return boost::hash< value_type >()(value); }
     inline friend std::size_t
     hash_value(index_t const & this_)
     { return this_.hash_value(); }
 
     inline friend std::ostream&
     operator<<(std::ostream& o, index_t const & this_)
-    { return o << '(' << this_.i << ',' << this_.j << ')'; }
+    { return o << '(' << this_.i() << ',' << this_.j() << ')'; }
+
+private:
+    value_type value;
 };
 
+/*******************************************************************************
+ ******************************************************************************/
+
+inline index_t::value_type
+index_t::
+delta(char const c)
+{
+    // Indexed by the low 5 bits of c, which differ among the moves.  Deltas
+    // wrap around, so that stepping up or left is adding 2^32 - delta.
+    static value_type const deltas[32] = {
+        0, 0, 0, 0, stride, 0, 0, 0,            // 'D' = 4
+        0, 0, 0, 0, value_type(-1), 0, 0, 0,    // 'L' = 12
+        0, 0, 1, 0, 0, value_type(-stride), 0, 0, // 'R' = 18, 'U' = 21
+        0, 0, 0, 0, 0, 0, 0, 0
+    };
+    assert(c == 'L' || c == 'R' || c == 'U' || c == 'D'
+        || c == 'W' || c == 'S' || c == 'A');
+    return deltas[c & 31];
+}
+
 } // namespace icfp2012
 
 #endif // #ifndef ICFP_2012_SOURCE_INDEX_T_HPP
@@ -0,0 +1,108 @@
+/*******************************************************************************
+ * icfp/2012/source/macro_dfs_max_score.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cstddef>
+
+#include <deque>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "anytime_t.hpp"
+#include "arena_t.hpp"
+#include "dead_state_analyzer_t.hpp"
+#include "delta_t.hpp"
+#include "macro_dfs_max_score.hpp"
+#include "macro_moves.hpp"
+
+namespace icfp2012
+{
+
+namespace
+{
+
+struct search_t
+{
+    dead_state_analyzer_t const analyzer;
+    std::size_t const max_visited_states;
+    anytime_t* const anytime;
+
+    boost::unordered_set< boost::uint64_t > visited;
+    // The moves from the start to the state being searched.
+    std::deque< char > moves;
+    int best_score;
+    std::deque< char > best_path;
+
+    search_t(
+        delta_t const & start,
+        std::size_t const max_visited_states_,
+        anytime_t* const anytime_)
+        : analyzer(start.apply()),
+          max_visited_states(max_visited_states_),
+          anytime(anytime_),
+          best_score(start.score())
+    { visited.insert(start.full_hash()); }
+
+    bool is_done() const
+    {
+        return visited.size() >= max_visited_states
+            || (anytime && anytime->is_expired());
+    }
+
+    void operator()(delta_t const & state)
+    {
+        std::vector< macro_move_t > macros;
+        macro_moves(state, macros);
+        for(std::size_t k = 0; k != macros.size() && !is_done(); ++k) {
+            macro_move_t const & macro = macros[k];
+            if(analyzer.is_dead(macro.state, best_score)
+            || !visited.insert(macro.state.full_hash()).second)
+                continue;
+            moves.insert(moves.end(), macro.moves.begin(), macro.moves.end());
+            int const score = macro.state.score();
+            if(score > best_score) {
+                best_score = score;
+                best_path = moves;
+                if(anytime)
+                    anytime->offer(best_path, best_score);
+            }
+            (*this)(macro.state);
+            moves.resize(moves.size() - macro.moves.size());
+        }
+    }
+};
+
+} // namespace
+
+/*******************************************************************************
+ * macro_dfs_max_score(
+ *     delta_t const & start,
+ *     std::deque< char >& path,
+ *     std::size_t const max_visited_states,
+ *     anytime_t* const anytime)
+ *     -> void
+ ******************************************************************************/
+
+void
+macro_dfs_max_score(
+    delta_t const & start,
+    std::deque< char >& path,
+    std::size_t const max_visited_states /*=
+        std::numeric_limits< std::size_t >::max()*/,
+    anytime_t* const anytime /*= 0*/)
+{
+    arena_t arena;
+    delta_t start_(start);
+    start_.cell_map.set_arena(&arena);
+    search_t search(start_, max_visited_states, anytime);
+    search(start_);
+    path.swap(search.best_path);
+}
+
+} // namespace icfp2012
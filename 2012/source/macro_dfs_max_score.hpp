@@ -0,0 +1,39 @@
+/*******************************************************************************
+ * icfp/2012/source/macro_dfs_max_score.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_MACRO_DFS_MAX_SCORE_HPP
+#define ICFP_2012_SOURCE_MACRO_DFS_MAX_SCORE_HPP
+
+#include <cstddef>
+
+#include <deque>
+#include <limits>
+
+#include "anytime_t.hpp"
+#include "delta_t.hpp"
+
+namespace icfp2012
+{
+
+// A depth-first search for the route with the highest score which branches
+// over macro moves (see macro_moves) rather than single moves: each step walks
+// the robot to a lambda, a razor or the open lift, nearest first.  States seen
+// before are not searched again, nor are dead states (see
+// dead_state_analyzer_t), which cannot beat the best score found so far.  The
+// search ends after max_visited_states states or once anytime expires, with
+// the best route found by then.
+void macro_dfs_max_score(
+    delta_t const & start,
+    std::deque< char >& path,
+    std::size_t const max_visited_states =
+        std::numeric_limits< std::size_t >::max(),
+    anytime_t* const anytime = 0);
+
+} // namespace icfp2012
+
+#endif // #define ICFP_2012_SOURCE_MACRO_DFS_MAX_SCORE_HPP
@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * icfp/2012/source/macro_moves.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "delta_t.hpp"
+#include "index_t.hpp"
+#include "macro_moves.hpp"
+
+namespace icfp2012
+{
+
+namespace
+{
+
+char const steps[] = { 'L', 'R', 'U', 'D' };
+
+struct node_t
+{
+    delta_t state;
+    std::size_t parent;
+    char move;
+    std::size_t n_moves;
+
+    node_t(
+        delta_t const & state_,
+        std::size_t const parent_,
+        char const move_,
+        std::size_t const n_moves_)
+        : state(state_),
+          parent(parent_),
+          move(move_),
+          n_moves(n_moves_)
+    { }
+};
+
+bool is_target(char const cell)
+{ return cell == '\\' || cell == '!' || cell == 'O'; }
+
+} // namespace
+
+/*******************************************************************************
+ * macro_move_t::macro_move_t(
+ *     index_t const target_index_,
+ *     char const target_cell_,
+ *     delta_t const & state_)
+ ******************************************************************************/
+
+macro_move_t::
+macro_move_t(
+    index_t const target_index_,
+    char const target_cell_,
+    delta_t const & state_)
+    : target_index(target_index_),
+      target_cell(target_cell_),
+      state(state_)
+{ }
+
+/*******************************************************************************
+ * macro_moves(
+ *     delta_t const & state,
+ *     std::vector< macro_move_t >& result,
+ *     std::size_t const max_moves)
+ *     -> void
+ ******************************************************************************/
+
+void
+macro_moves(
+    delta_t const & state,
+    std::vector< macro_move_t >& result,
+    std::size_t const max_moves /*=
+        std::numeric_limits< std::size_t >::max()*/)
+{
+    if(state.robot_is_destroyed || state.robot_index == state.base.lift_index)
+        return;
+
+    std::vector< bool > visited(state.base.cells.size(), false);
+    visited[state.base.offset(state.robot_index)] = true;
+    // The elements of a deque do not move as it grows at the end.
+    std::deque< node_t > nodes;
+    nodes.push_back(node_t(state, 0, 0, 0));
+    for(std::size_t k = 0; k != nodes.size(); ++k) {
+        if(nodes[k].n_moves == max_moves)
+            continue;
+        for(std::size_t i = 0; i != 4; ++i) {
+            node_t const & node = nodes[k];
+            char const move = steps[i];
+            if(!node.state.move_is_valid(move))
+                continue;
+            // Stepping onto a trampoline lands the robot elsewhere, so the
+            // cell it ends up in is only known after the move.
+            index_t const dest_index = node.state.robot_index + move;
+            char const dest_cell = node.state[dest_index];
+            bool const is_trampoline = 'A' <= dest_cell && dest_cell <= 'I';
+            if(!is_trampoline && visited[state.base.offset(dest_index)])
+                continue;
+            delta_t const next = node.state.move_robot_update(move);
+            if(next.robot_is_destroyed)
+                continue;
+            std::size_t const offset = state.base.offset(next.robot_index);
+            if(visited[offset])
+                continue;
+            visited[offset] = true;
+            if(!is_target(dest_cell)) {
+                nodes.push_back(node_t(next, k, move, node.n_moves + 1));
+                continue;
+            }
+            result.push_back(macro_move_t(dest_index, dest_cell, next));
+            std::vector< char >& moves = result.back().moves;
+            moves.resize(node.n_moves + 1);
+            moves[node.n_moves] = move;
+            for(std::size_t j = k; j != 0; j = nodes[j].parent)
+                moves[nodes[j].n_moves - 1] = nodes[j].move;
+        }
+    }
+}
+
+} // namespace icfp2012
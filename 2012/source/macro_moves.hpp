@@ -0,0 +1,54 @@
+/*******************************************************************************
+ * icfp/2012/source/macro_moves.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_MACRO_MOVES_HPP
+#define ICFP_2012_SOURCE_MACRO_MOVES_HPP
+
+#include <cstddef>
+
+#include <limits>
+#include <vector>
+
+#include "delta_t.hpp"
+#include "index_t.hpp"
+
+namespace icfp2012
+{
+
+// A walk of the robot to a lambda, a razor or the open lift, as the moves
+// which make it and the state they lead to.
+struct macro_move_t
+{
+    index_t target_index;
+    char target_cell;
+    std::vector< char > moves;
+    delta_t state;
+
+    macro_move_t(
+        index_t const target_index_,
+        char const target_cell_,
+        delta_t const & state_);
+};
+
+// Appends to result a macro move to each lambda, razor and open lift the robot
+// can walk to from state in at most max_moves moves, in order of the number of
+// moves.  The walks are found by a breadth-first search over the robot's cell
+// in which every move is simulated with delta_t::move_robot_update, so each
+// walk is a shortest one among those the search tries which keep the robot
+// alive, with rocks falling and the water rising as they go.  Only the first
+// route to reach a cell is extended, and walks end at the first target they
+// reach, so a walk which must wait ('W') or shave ('S') on the way, or pass
+// through another target, is not found.
+void macro_moves(
+    delta_t const & state,
+    std::vector< macro_move_t >& result,
+    std::size_t const max_moves = std::numeric_limits< std::size_t >::max());
+
+} // namespace icfp2012
+
+#endif // #define ICFP_2012_SOURCE_MACRO_MOVES_HPP
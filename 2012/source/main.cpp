@@ -10,22 +10,79 @@
 #include <cstddef>
 #include <cstdlib>
 
+#include <algorithm>
 #include <deque>
 #include <fstream>
 #include <iostream>
 #include <limits>
+#include <utility>
 
 #include <boost/foreach.hpp>
+#include <boost/optional.hpp>
 
+#include "anytime_t.hpp"
+#include "arena_t.hpp"
+#include "beam_search_max_score.hpp"
+#include "best_first_max_score.hpp"
 #include "bfs_max_score.hpp"
+#include "bitboard_t.hpp"
 #include "delta_t.hpp"
 #include "dfs_bfs_max_score.hpp"
+#include "distance_fields_t.hpp"
 #include "index_t.hpp"
+#include "macro_dfs_max_score.hpp"
+#include "mcts_max_score.hpp"
 #include "state_t.hpp"
+#include "world_timeline_t.hpp"
+
+namespace
+{
+
+// Whether, on the turn move is made from state, a beard would grow into a cell
+// a rock falls into.  The world updates assume the updates of a turn have
+// distinct destinations and assert otherwise.
+bool rock_falls_into_beard(icfp2012::state_t const & state, char const move)
+{
+    using icfp2012::state_t;
+    if(state.beard_growth_rate == 0
+    || (state.n_turns + 1) % state.beard_growth_rate != 0)
+        return false;
+    // The same turn without beard growth moves the rocks the same way, and
+    // leaves the beards as the move does.
+    state_t moved(state);
+    moved.beard_growth_rate = 0;
+    state_t::undo_t undo;
+    moved.move_robot_update_ip(move, undo);
+    std::size_t const robot_offset = state.offset(state.robot_index);
+    std::ptrdiff_t const step = move == 'L' ? -1 : move == 'R' ? 1 : 0;
+    char const pushed_cell = state.cells[robot_offset + step];
+    bool const rock_is_pushed =
+        step != 0 && (pushed_cell == '*' || pushed_cell == '@');
+    typedef std::pair< std::size_t, char > offset_cell_type;
+    BOOST_FOREACH( offset_cell_type const offset_cell, undo.cells ) {
+        std::size_t const offset = offset_cell.first;
+        char const cell = moved.cells[offset];
+        if(cell == state.cells[offset]
+        || !(cell == '*' || cell == '@' || cell == '\\'))
+            continue;
+        if(rock_is_pushed && offset == robot_offset + 2 * step)
+            continue;
+        for(std::size_t i = offset - state.n_cols; i <= offset + state.n_cols;
+            i += state.n_cols)
+            for(std::size_t j = i - 1; j != i + 2; ++j)
+                if(moved.cells[j] == 'W')
+                    return true;
+    }
+    return false;
+}
+
+} // namespace
 
 int main(int argc, char* argv[])
 {
+    using icfp2012::bitboard_t;
     using icfp2012::delta_t;
+    using icfp2012::distance_fields_t;
     using icfp2012::index_t;
     using icfp2012::state_t;
 
@@ -42,7 +99,7 @@ int main(int argc, char* argv[])
             state.initialize(f);
         }
 
-        std::cout << "Water: " << state.cells.size() - state.water_level << std::endl;
+        std::cout << "Water: " << state.n_rows - 1 - state.water_level << std::endl;
         std::cout << "Flooding: " << state.flooding_rate << std::endl;
         std::cout << "Waterproof: " << state.waterproof << std::endl;
         std::cout << "Growth: " << state.beard_growth_rate << std::endl;
@@ -55,9 +112,23 @@ int main(int argc, char* argv[])
 
         state_t const base(state);
         delta_t delta(base);
+        icfp2012::world_timeline_t const timeline(delta);
 
         state_t simplified_state(state);
         simplified_state.simplify_ip();
+        state_t const simplified_base(simplified_state);
+        // Simplified incrementally, so must match simplified_state.
+        state_t incrementally_simplified_state(simplified_state);
+        delta_t simplified_delta(simplified_base);
+        icfp2012::world_timeline_t const simplified_timeline(simplified_delta, true);
+        bool const base_has_beards =
+            std::find(state.cells.begin(), state.cells.end(), 'W')
+         != state.cells.end();
+
+        bitboard_t bitboard(state);
+
+        distance_fields_t distance_fields(state);
+        distance_fields_t simplified_distance_fields(simplified_state);
 
         std::cout << simplified_state << std::endl;
 
@@ -68,29 +139,135 @@ int main(int argc, char* argv[])
             bool const move_is_valid = state.move_is_valid(move);
             assert(move_is_valid == delta.move_is_valid(move));
             assert(move_is_valid == simplified_state.move_is_valid(move));
+            assert(move_is_valid == bitboard.move_is_valid(move));
             if(!move_is_valid)
                 move = 'W';
 
+            state_t const old_state(state);
+            state_t undone_state(state);
+            state_t::undo_t undo;
+            undone_state.move_robot_update_ip(move, undo);
+
             state.move_robot_update_ip(move);
+            assert(undone_state.cells == state.cells);
+            assert(state.n_beards == static_cast< unsigned int >(
+                std::count(state.cells.begin(), state.cells.end(), 'W')));
+            assert(undone_state.active_indices == state.active_indices);
+            distance_fields.update(state, undo);
+
+            undone_state.undo_move_ip(undo);
+            assert(undone_state.cells == old_state.cells);
+            assert(undone_state.active_indices == old_state.active_indices);
+#define assert_equal( member ) assert(old_state.member == undone_state.member)
+            assert_equal(robot_index);
+            assert_equal(n_turns);
+            assert_equal(n_lambdas_remaining);
+            assert_equal(n_lambdas_collected);
+            assert_equal(robot_is_destroyed);
+            assert_equal(water_level);
+            assert_equal(n_turns_underwater);
+            assert_equal(n_razors);
+            assert_equal(n_beards);
+#undef assert_equal
+
+            {
+                // Every move but those which would trip an assertion of the
+                // world update (see rock_falls_into_beard) is cross-checked.
+                static char const all_moves[] = { 'L', 'R', 'U', 'D', 'S', 'W' };
+                char moves[sizeof( all_moves )];
+                std::size_t n_moves = 0;
+                for(std::size_t i = 0; i != sizeof( all_moves ); ++i)
+                    if(!rock_falls_into_beard(old_state, all_moves[i]))
+                        moves[n_moves++] = all_moves[i];
+                boost::optional< delta_t > successors[sizeof( all_moves )];
+                boost::optional< delta_t > timeline_successors[sizeof( all_moves )];
+                delta.move_robot_update(
+                    moves, n_moves, successors, delta.cell_map.get_arena());
+                delta.move_robot_update(
+                    moves, n_moves, timeline_successors,
+                    delta.cell_map.get_arena(), &timeline, false, true);
+                for(std::size_t i = 0; i != n_moves; ++i) {
+                    assert(successors[i].is_initialized() == delta.move_is_valid(moves[i]));
+                    assert(timeline_successors[i].is_initialized() == delta.move_is_valid(moves[i]));
+                    if(!successors[i])
+                        continue;
+                    delta_t const successor = delta.move_robot_update(moves[i]);
+                    assert(*successors[i] == successor);
+                    assert(successors[i]->n_turns == successor.n_turns);
+                    assert(successors[i]->active_indices == successor.active_indices);
+                    assert(*timeline_successors[i] == successor);
+                    assert(timeline_successors[i]->n_turns == successor.n_turns);
+                    assert(timeline_successors[i]->active_indices == successor.active_indices);
+                }
+            }
 
             delta = delta.move_robot_update(move);
 
             simplified_state.move_robot_update_ip(move);
             simplified_state.simplify_ip();
+            simplified_distance_fields.update(simplified_state);
+
+            {
+                state_t const old_simplified_state(incrementally_simplified_state);
+                state_t::undo_t simplify_undo;
+                incrementally_simplified_state.move_robot_update_ip(move, simplify_undo);
+                incrementally_simplified_state.simplify_ip(simplify_undo);
+                assert(incrementally_simplified_state.cells == simplified_state.cells);
+                state_t undone_simplified_state(incrementally_simplified_state);
+                undone_simplified_state.undo_move_ip(simplify_undo);
+                assert(undone_simplified_state.cells == old_simplified_state.cells);
+
+                boost::optional< delta_t > simplified_successor;
+                simplified_delta.move_robot_update(
+                    &move, 1, &simplified_successor,
+                    simplified_delta.cell_map.get_arena(), &simplified_timeline, true);
+                delta_t next_simplified_delta = simplified_delta.move_robot_update(move);
+                next_simplified_delta.simplify_ip(simplified_delta);
+                assert(next_simplified_delta.robot_is_destroyed || *simplified_successor == next_simplified_delta);
+                simplified_delta.swap(next_simplified_delta);
+                for(std::size_t i = 1; i != state.n_rows - 1; ++i) {
+                    for(std::size_t j = 1; j != state.n_cols - 1; ++j) {
+                        index_t const index(i,j);
+                        char const simplified_cell = simplified_delta[index];
+                        assert(simplified_cell == incrementally_simplified_state[i][j]
+                            || (base_has_beards && simplified_cell == '.'
+                             && incrementally_simplified_state[i][j] == ' '));
+                    }
+                }
+            }
+
+            bitboard.move_robot_update_ip(move);
 
             bool const robot_is_destroyed = state.robot_is_destroyed;
             assert(robot_is_destroyed == delta.robot_is_destroyed);
             assert(robot_is_destroyed == simplified_state.robot_is_destroyed);
+            assert(robot_is_destroyed == bitboard.robot_is_destroyed);
 
             if(!robot_is_destroyed) {
-                for(std::size_t i = 0; i != state.cells.size(); ++i) {
-                    for(std::size_t j = 0; j != state[i].size(); ++j) {
+                distance_fields_t const new_distance_fields(state);
+                distance_fields_t const new_simplified_distance_fields(simplified_state);
+                for(std::size_t i = 1; i != state.n_rows - 1; ++i) {
+                    for(std::size_t j = 1; j != state.n_cols - 1; ++j) {
                         char const cell = state[i][j];
                         assert(cell == delta[index_t(i,j)]);
+                        assert(cell == bitboard[index_t(i,j)]);
                         char const simplified_cell = simplified_state[i][j];
                         assert(cell == simplified_cell
                             || ((cell == '*' || cell == '@') && simplified_cell == '+')
                             || (cell == '.' && simplified_cell == ' '));
+                        index_t const index(i,j);
+                        assert(distance_fields.lift_distance(index) == new_distance_fields.lift_distance(index));
+                        assert(distance_fields.nearest_lambda_distance(index) == new_distance_fields.nearest_lambda_distance(index));
+                        assert(simplified_distance_fields.lift_distance(index) == new_simplified_distance_fields.lift_distance(index));
+                        assert(simplified_distance_fields.nearest_lambda_distance(index) == new_simplified_distance_fields.nearest_lambda_distance(index));
+                        if(cell != '\\')
+                            continue;
+                        for(std::size_t k = 1; k != state.n_rows - 1; ++k) {
+                            for(std::size_t l = 1; l != state.n_cols - 1; ++l) {
+                                assert(distance_fields.lambda_distance(index, index_t(k,l)) == new_distance_fields.lambda_distance(index, index_t(k,l)));
+                                assert(simplified_distance_fields.lambda_distance(index, index_t(k,l)) == new_simplified_distance_fields.lambda_distance(index, index_t(k,l)));
+                            }
+                        }
                     }
                 }
                 assert(state.active_indices.size() == delta.active_indices.size());
@@ -98,6 +275,7 @@ int main(int argc, char* argv[])
                 int const score = state.score();
                 assert(score == delta.score());
                 assert(score == simplified_state.score());
+                assert(score == bitboard.score());
                 assert(state.water_level == delta.water_level());
 #define assert_equal( member ) assert(state.member == delta.member)
                 assert_equal(robot_index);
@@ -115,6 +293,15 @@ int main(int argc, char* argv[])
                 assert_equal(water_level);
                 assert_equal(n_turns_underwater);
                 assert_equal(n_razors);
+#undef assert_equal
+#define assert_equal( member ) assert(state.member == bitboard.member)
+                assert_equal(robot_index);
+                assert_equal(n_turns);
+                assert_equal(n_lambdas_remaining);
+                assert_equal(n_lambdas_collected);
+                assert_equal(water_level);
+                assert_equal(n_turns_underwater);
+                assert_equal(n_razors);
 #undef assert_equal
                 std::cout << simplified_state << std::endl;
                 if(state.robot_index == state.lift_index)
@@ -135,11 +322,21 @@ int main(int argc, char* argv[])
         enum strategy_e
         {
             strategy_e_bfs_max_score,
-            strategy_e_dfs_bfs_max_score
+            strategy_e_dfs_bfs_max_score,
+            strategy_e_best_first_max_score,
+            strategy_e_beam_search_max_score,
+            strategy_e_mcts_max_score,
+            strategy_e_macro_dfs_max_score,
+            strategy_e_anytime
         } strategy;
         std::size_t const size_t_max = std::numeric_limits< std::size_t >::max();
         std::size_t max_visited_states = size_t_max;
         std::size_t max_branches = size_t_max;
+        std::size_t beam_width = 0;
+        std::size_t max_per_robot_index = size_t_max;
+        std::size_t max_playouts = size_t_max;
+        std::size_t n_threads = 1;
+        double seconds = 0;
         if(argc > 2) {
             std::ifstream f(argv[1]);
             if(f.fail()) {
@@ -148,17 +345,55 @@ int main(int argc, char* argv[])
             }
             std::string s(argv[2]);
             if(s == "bfs_max_score") {
-                assert(argc == 3 || argc == 4);
+                assert(3 <= argc && argc <= 5);
                 strategy = strategy_e_bfs_max_score;
-                if(argc == 4)
+                if(argc >= 4)
                     max_visited_states = static_cast< std::size_t >(std::atoi(argv[3]));
+                if(argc == 5)
+                    n_threads = static_cast< std::size_t >(std::atoi(argv[4]));
             }
             else if(s == "dfs_bfs_max_score") {
-                assert(argc == 4 || argc == 5);
+                assert(4 <= argc && argc <= 6);
                 strategy = strategy_e_dfs_bfs_max_score;
                 max_visited_states = static_cast< std::size_t >(std::atoi(argv[3]));
-                if(argc == 5)
+                if(argc >= 5)
                     max_branches = static_cast< std::size_t >(std::atoi(argv[4]));
+                if(argc == 6)
+                    n_threads = static_cast< std::size_t >(std::atoi(argv[5]));
+            }
+            else if(s == "best_first_max_score") {
+                assert(argc == 3 || argc == 4);
+                strategy = strategy_e_best_first_max_score;
+                if(argc == 4)
+                    max_visited_states = static_cast< std::size_t >(std::atoi(argv[3]));
+            }
+            else if(s == "beam_search_max_score") {
+                assert(argc == 4 || argc == 5);
+                strategy = strategy_e_beam_search_max_score;
+                beam_width = static_cast< std::size_t >(std::atoi(argv[3]));
+                if(argc == 5)
+                    max_per_robot_index = static_cast< std::size_t >(std::atoi(argv[4]));
+            }
+            else if(s == "mcts_max_score") {
+                assert(argc == 4 || argc == 5);
+                strategy = strategy_e_mcts_max_score;
+                max_playouts = static_cast< std::size_t >(std::atoi(argv[3]));
+                if(argc == 5)
+                    n_threads = static_cast< std::size_t >(std::atoi(argv[4]));
+            }
+            else if(s == "macro_dfs_max_score") {
+                assert(argc == 3 || argc == 4);
+                strategy = strategy_e_macro_dfs_max_score;
+                if(argc == 4)
+                    max_visited_states = static_cast< std::size_t >(std::atoi(argv[3]));
+            }
+            else if(s == "anytime") {
+                assert(3 <= argc && argc <= 5);
+                strategy = strategy_e_anytime;
+                if(argc >= 4)
+                    seconds = std::atof(argv[3]);
+                n_threads = argc == 5 ?
+                    static_cast< std::size_t >(std::atoi(argv[4])) : 0;
             }
             else {
                 std::cerr << "Unknown strategy parameter \"" << s << '"' << std::endl;
@@ -167,12 +402,45 @@ int main(int argc, char* argv[])
             state.initialize(f);
         }
         else {
+            // Contest mode: run until interrupted.
             assert(argc == 1);
             state.initialize(std::cin);
-            strategy = strategy_e_bfs_max_score;
+            strategy = strategy_e_anytime;
+            n_threads = 0;
+        }
+
+        if(strategy == strategy_e_anytime) {
+            // Print only the route, once the deadline passes or on SIGINT.
+            // Searches with doubling budgets refine the best route so far
+            // until then, on one thread per hardware thread (n_threads of 0)
+            // unless told otherwise.  Each search level branches into the
+            // few best states found, so that the budget goes to depth.
+            std::size_t const anytime_max_branches = 2;
+            icfp2012::anytime_t anytime(seconds);
+            std::deque< char > path;
+            for(std::size_t max_visited_states = 1024;
+                !anytime.is_expired()
+             && max_visited_states <= size_t_max / 2;
+                max_visited_states *= 2) {
+                path.clear();
+                icfp2012::dfs_bfs_max_score(
+                    delta_t(state), path, max_visited_states,
+                    anytime_max_branches, n_threads, &anytime);
+            }
+            path = anytime.best_path();
+            state.move_robot_update_ip(path);
+            BOOST_FOREACH( char const move, path )
+                std::cout << move;
+            // The score of an unfinished route assumes it is aborted.
+            if(state.robot_index != state.lift_index
+            && !state.robot_is_destroyed
+            && state.n_lambdas_collected != 0)
+                std::cout << 'A';
+            std::cout << std::endl;
+            return 0;
         }
 
-        std::cout << "Water: " << state.cells.size() - state.water_level << std::endl;
+        std::cout << "Water: " << state.n_rows - 1 - state.water_level << std::endl;
         std::cout << "Flooding: " << state.flooding_rate << std::endl;
         std::cout << "Waterproof: " << state.waterproof << std::endl;
         std::cout << "Growth: " << state.beard_growth_rate << std::endl;
@@ -185,11 +453,45 @@ int main(int argc, char* argv[])
 
         std::deque< char > path;
         switch(strategy) {
-        case strategy_e_bfs_max_score:
-            icfp2012::bfs_max_score(delta_t(state), path, max_visited_states);
+        case strategy_e_bfs_max_score: {
+            icfp2012::arena_t::stats_t arena_stats;
+            icfp2012::bfs_max_score(
+                delta_t(state), path, max_visited_states, n_threads,
+                &arena_stats);
+            std::cout << "Arena: "
+                      << arena_stats.n_allocations << " allocations ("
+                      << arena_stats.n_reuses << " reused), "
+                      << arena_stats.n_bytes_allocated << " bytes allocated, "
+                      << arena_stats.n_bytes_reserved << " bytes reserved in "
+                      << arena_stats.n_blocks << " blocks" << std::endl;
             break;
+        }
         case strategy_e_dfs_bfs_max_score:
-            icfp2012::dfs_bfs_max_score(delta_t(state), path, max_visited_states, max_branches);
+            icfp2012::dfs_bfs_max_score(delta_t(state), path, max_visited_states, max_branches, n_threads);
+            break;
+        case strategy_e_best_first_max_score:
+            icfp2012::best_first_max_score(delta_t(state), path, max_visited_states);
+            break;
+        case strategy_e_beam_search_max_score:
+            icfp2012::beam_search_max_score(delta_t(state), path, beam_width, max_per_robot_index);
+            break;
+        case strategy_e_mcts_max_score: {
+            icfp2012::mcts_stats_t mcts_stats;
+            icfp2012::mcts_max_score(
+                delta_t(state), path, max_playouts, n_threads, 0,
+                &mcts_stats);
+            std::cout << "Playouts: "
+                      << mcts_stats.n_playouts << " in "
+                      << mcts_stats.seconds << " s ("
+                      << mcts_stats.n_playouts / std::max(mcts_stats.seconds, 1e-6)
+                      << " per second)" << std::endl;
+            break;
+        }
+        case strategy_e_macro_dfs_max_score:
+            icfp2012::macro_dfs_max_score(delta_t(state), path, max_visited_states);
+            break;
+        case strategy_e_anytime:
+            assert(false);
             break;
         }
 
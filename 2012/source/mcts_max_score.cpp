@@ -0,0 +1,331 @@
+/*******************************************************************************
+ * icfp/2012/source/mcts_max_score.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+#include "anytime_t.hpp"
+#include "bfs.hpp"
+#include "delta_t.hpp"
+#include "index_t.hpp"
+#include "mcts_max_score.hpp"
+#include "state_t.hpp"
+#include "thread_pool_t.hpp"
+
+namespace icfp2012
+{
+
+namespace
+{
+
+// The tree stops growing at this many nodes; playouts then start their random
+// phase from whichever leaf they reach.
+std::size_t const max_nodes = 1 << 22;
+
+double const exploration = 0.5;
+
+struct node_t
+{
+    char move;
+    bool is_expanded;
+    std::size_t first_child;
+    std::size_t n_children;
+    std::size_t n_visits;
+    double total_value;
+
+    explicit node_t(char const move_)
+        : move(move_),
+          is_expanded(false),
+          first_child(0),
+          n_children(0),
+          n_visits(0),
+          total_value(0)
+    { }
+};
+
+bool is_terminal(state_t const & state)
+{ return state.robot_is_destroyed || state.robot_index == state.lift_index; }
+
+// One search tree, grown by playouts from root.
+class tree_t
+{
+public:
+    int best_score;
+    std::deque< char > best_path;
+    std::size_t n_playouts;
+
+    tree_t(state_t const & root_, unsigned int const seed)
+        : best_score(root_.score()),
+          n_playouts(0),
+          root(root_),
+          rng(seed),
+          max_turns(root_.n_rows * root_.n_cols),
+          max_rollout_turns(root_.n_rows + root_.n_cols),
+          value_scale(1.0 / std::max(
+              75.0 * (root_.n_lambdas_collected + root_.n_lambdas_remaining),
+              1.0))
+    { nodes.push_back(node_t(0)); }
+
+    void playout();
+
+private:
+    state_t const & root;
+    boost::mt19937 rng;
+    std::size_t const max_turns;
+    std::size_t const max_rollout_turns;
+    double const value_scale;
+
+    std::deque< node_t > nodes;
+
+    // Reused from one playout to the next.
+    state_t scratch;
+    std::vector< std::size_t > node_path;
+    std::vector< char > moves;
+    int max_score;
+    std::size_t n_max_score_moves;
+
+    void move(char const move_);
+    std::size_t select(node_t const & parent) const;
+    void expand(node_t& node);
+    char rollout_move();
+};
+
+void tree_t::move(char const move_)
+{
+    scratch.move_robot_update_ip(move_);
+    moves.push_back(move_);
+    int const score = scratch.score();
+    if(score > max_score) {
+        max_score = score;
+        n_max_score_moves = moves.size();
+    }
+}
+
+std::size_t tree_t::select(node_t const & parent) const
+{
+    double const log_n_visits = std::log(static_cast< double >(parent.n_visits));
+    std::size_t result = parent.first_child;
+    double max_value = -1;
+    for(std::size_t k = parent.first_child;
+        k != parent.first_child + parent.n_children;
+        ++k) {
+        node_t const & child = nodes[k];
+        if(child.n_visits == 0)
+            return k;
+        double const value =
+            child.total_value / child.n_visits
+          + exploration * std::sqrt(log_n_visits / child.n_visits);
+        if(value > max_value) {
+            max_value = value;
+            result = k;
+        }
+    }
+    return result;
+}
+
+void tree_t::expand(node_t& node)
+{
+    node.is_expanded = true;
+    if(is_terminal(scratch) || nodes.size() >= max_nodes)
+        return;
+    // node stays valid as nodes grows, since the elements of a deque do not
+    // move as it grows at the end.
+    node.first_child = nodes.size();
+    for(std::size_t i = 0; i != bfs_detail::n_moves; ++i) {
+        char const move_ = bfs_detail::moves[i];
+        if(scratch.move_is_valid(move_))
+            nodes.push_back(node_t(move_));
+    }
+    node.n_children = nodes.size() - node.first_child;
+}
+
+// Takes an adjacent lambda or the open lift if there is one, and otherwise
+// moves (or shaves) at random, waiting only if nothing else is valid.
+char tree_t::rollout_move()
+{
+    static char const steps[] = { 'L', 'R', 'U', 'D' };
+    char candidates[5];
+    std::size_t n_candidates = 0;
+    for(std::size_t i = 0; i != 4; ++i) {
+        char const step = steps[i];
+        char const cell = scratch[scratch.robot_index + step];
+        if(cell == '\\' || cell == 'O')
+            return step;
+        if(scratch.move_is_valid(step))
+            candidates[n_candidates++] = step;
+    }
+    if(scratch.n_razors != 0 && scratch.move_is_valid('S'))
+        candidates[n_candidates++] = 'S';
+    if(n_candidates == 0)
+        return 'W';
+    return candidates[rng() % n_candidates];
+}
+
+void tree_t::playout()
+{
+    scratch = root;
+    node_path.clear();
+    moves.clear();
+    max_score = scratch.score();
+    n_max_score_moves = 0;
+
+    // Selection.
+    std::size_t k = 0;
+    node_path.push_back(k);
+    while(nodes[k].is_expanded && nodes[k].n_children != 0) {
+        k = select(nodes[k]);
+        node_path.push_back(k);
+        move(nodes[k].move);
+    }
+
+    // Expansion.
+    if(!nodes[k].is_expanded) {
+        expand(nodes[k]);
+        if(nodes[k].n_children != 0) {
+            k = nodes[k].first_child + rng() % nodes[k].n_children;
+            node_path.push_back(k);
+            move(nodes[k].move);
+        }
+    }
+
+    // Rollout.
+    for(std::size_t n = 0;
+        n != max_rollout_turns
+     && !is_terminal(scratch)
+     && scratch.n_turns < max_turns;
+        ++n)
+        move(rollout_move());
+
+    // Backpropagation.
+    double const value = std::max(max_score, 0) * value_scale;
+    for(std::size_t i = 0; i != node_path.size(); ++i) {
+        node_t& node = nodes[node_path[i]];
+        ++node.n_visits;
+        node.total_value += value;
+    }
+
+    if(max_score > best_score) {
+        best_score = max_score;
+        best_path.assign(moves.begin(), moves.begin() + n_max_score_moves);
+    }
+    ++n_playouts;
+}
+
+struct search_t
+{
+    state_t const & root;
+    std::size_t const max_playouts;
+    anytime_t* const anytime;
+    std::vector< int >& scores;
+    std::vector< std::deque< char > >& paths;
+    std::vector< std::size_t >& n_playouts;
+
+    search_t(
+        state_t const & root_,
+        std::size_t const max_playouts_,
+        anytime_t* const anytime_,
+        std::vector< int >& scores_,
+        std::vector< std::deque< char > >& paths_,
+        std::vector< std::size_t >& n_playouts_)
+        : root(root_),
+          max_playouts(max_playouts_),
+          anytime(anytime_),
+          scores(scores_),
+          paths(paths_),
+          n_playouts(n_playouts_)
+    { }
+
+    typedef void result_type;
+
+    void operator()(std::size_t const k, std::size_t) const
+    {
+        tree_t tree(root, static_cast< unsigned int >(k + 1));
+        while(tree.n_playouts != max_playouts) {
+            if(anytime && tree.n_playouts % 64 == 0 && anytime->is_expired())
+                break;
+            int const best_score = tree.best_score;
+            tree.playout();
+            if(anytime && tree.best_score > best_score)
+                anytime->offer(tree.best_path, tree.best_score);
+        }
+        scores[k] = tree.best_score;
+        paths[k].swap(tree.best_path);
+        n_playouts[k] = tree.n_playouts;
+    }
+};
+
+} // namespace
+
+/*******************************************************************************
+ * mcts_stats_t::mcts_stats_t()
+ ******************************************************************************/
+
+mcts_stats_t::
+mcts_stats_t()
+    : n_playouts(0),
+      seconds(0)
+{ }
+
+/*******************************************************************************
+ * mcts_max_score(
+ *     delta_t const & start,
+ *     std::deque< char >& path,
+ *     std::size_t const max_playouts,
+ *     std::size_t const n_threads,
+ *     anytime_t* const anytime,
+ *     mcts_stats_t* const stats)
+ *     -> void
+ ******************************************************************************/
+
+void
+mcts_max_score(
+    delta_t const & start,
+    std::deque< char >& path,
+    std::size_t const max_playouts,
+    std::size_t const n_threads /*= 1*/,
+    anytime_t* const anytime /*= 0*/,
+    mcts_stats_t* const stats /*= 0*/)
+{
+    boost::posix_time::ptime const start_time =
+        boost::posix_time::microsec_clock::universal_time();
+
+    state_t const root = start.apply();
+    thread_pool_t pool(n_threads);
+    std::size_t const n_trees = pool.size();
+    std::vector< int > scores(n_trees);
+    std::vector< std::deque< char > > paths(n_trees);
+    std::vector< std::size_t > n_playouts(n_trees);
+    pool.for_each_index(
+        n_trees,
+        search_t(
+            root, std::max< std::size_t >(max_playouts / n_trees, 1), anytime,
+            scores, paths, n_playouts));
+
+    std::size_t const k =
+        std::max_element(scores.begin(), scores.end()) - scores.begin();
+    path.swap(paths[k]);
+
+    if(stats) {
+        stats->n_playouts = 0;
+        for(std::size_t t = 0; t != n_trees; ++t)
+            stats->n_playouts += n_playouts[t];
+        stats->seconds = 1e-6 * (
+            boost::posix_time::microsec_clock::universal_time() - start_time
+        ).total_microseconds();
+    }
+}
+
+} // namespace icfp2012
@@ -0,0 +1,50 @@
+/*******************************************************************************
+ * icfp/2012/source/mcts_max_score.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_MCTS_MAX_SCORE_HPP
+#define ICFP_2012_SOURCE_MCTS_MAX_SCORE_HPP
+
+#include <cstddef>
+
+#include <deque>
+
+#include "anytime_t.hpp"
+#include "delta_t.hpp"
+
+namespace icfp2012
+{
+
+struct mcts_stats_t
+{
+    std::size_t n_playouts;
+    double seconds;
+    mcts_stats_t();
+};
+
+// A Monte Carlo tree search (UCT) for the route with the highest score.  Each
+// playout descends the tree, expands a leaf and plays out randomly from there
+// (taking an adjacent lambda or the open lift whenever it can) on a scratch
+// state_t whose buffers are reused from one playout to the next.  A playout
+// is worth the best score of any of its prefixes, since a route may abort at
+// any turn, and the best such prefix over all playouts is returned.
+//
+// With more than one thread, each thread grows an independent tree with its
+// own random seed from max_playouts / n_threads playouts (root
+// parallelization), and the best route of any of them is returned.  The
+// search also ends once anytime expires.
+void mcts_max_score(
+    delta_t const & start,
+    std::deque< char >& path,
+    std::size_t const max_playouts,
+    std::size_t const n_threads = 1,
+    anytime_t* const anytime = 0,
+    mcts_stats_t* const stats = 0);
+
+} // namespace icfp2012
+
+#endif // #define ICFP_2012_SOURCE_MCTS_MAX_SCORE_HPP
@@ -26,8 +26,8 @@ move_is_valid(State const & state, char const move)
     if(move == 'S'){
         if(state.n_razors == 0)
             return false;
-        for(std::size_t i = state.robot_index.i-1; i != state.robot_index.i+2; ++i)
-            for(std::size_t j = state.robot_index.j-1; j != state.robot_index.j+2; ++j)
+        for(std::size_t i = state.robot_index.i()-1; i != state.robot_index.i()+2; ++i)
+            for(std::size_t j = state.robot_index.j()-1; j != state.robot_index.j()+2; ++j)
                 if(state[index_t(i,j)] == 'W')
                     return true;
         return false;
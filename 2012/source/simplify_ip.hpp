@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * icfp/2012/source/simplify_ip.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_SIMPLIFY_IP_HPP
+#define ICFP_2012_SOURCE_SIMPLIFY_IP_HPP
+
+#include <cstddef>
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "index_t.hpp"
+
+namespace icfp2012
+{
+
+inline bool
+is_unmovable(char const cell)
+{ return cell == '#' || cell == '+' || cell == 'L' || cell == 'O'; }
+
+inline bool
+is_movable_rock(char const cell)
+{ return cell == '*' || cell == '@'; }
+
+// Whether the (movable) rock at index can never move again, as long as the
+// unmovable cells around it stay so; such a rock is marked unmovable ('+').
+template< class State >
+inline bool
+rock_is_unmovable(State const & state, index_t const index)
+{
+    index_t const indexD = index + 'D';
+    char const cellD = state[indexD];
+    if(!is_unmovable(cellD))
+        return false;
+    char const cellL = state[index + 'L'];
+    char const cellDL = state[indexD + 'L'];
+    char const cellR = state[index + 'R'];
+    char const cellDR = state[indexD + 'R'];
+    return (cellD != '+'
+         || ((is_unmovable(cellL) || is_unmovable(cellDL))
+          && (is_unmovable(cellR) || is_unmovable(cellDR))))
+        && (is_unmovable(cellL)
+         || is_unmovable(cellR)
+         || (is_movable_rock(cellR)
+          && is_unmovable(cellDR)
+          && (cellDR != '+'
+           || is_unmovable(state[index + 'R' + 'R'])
+           || is_unmovable(state[indexD + 'R' + 'R']))));
+}
+
+namespace simplify_ip_detail
+{
+
+// Whether a movable rock may yet reach each cell, as the sweep of
+// state_t::simplify_ip over the rows finds it: a cell is reached if it is not
+// unmovable and either holds a rock, lies below a reached cell, or lies in a
+// run of cells between unmovable cells with an interior cell (one with no
+// unmovable cell on either side) which holds a rock or lies below a reached
+// cell.  Found from the cells above, each at most once, and memoized only for
+// the cells asked about, so the cost is independent of the map's size.
+template< class State >
+class reached_t
+{
+public:
+    explicit reached_t(State const & state_)
+        : state(state_)
+    { }
+
+    bool operator()(index_t const index)
+    {
+        if(is_unmovable(state[index]))
+            return false;
+        typename memo_type::const_iterator const it = is_reached.find(index);
+        if(it != is_reached.end())
+            return it->second;
+        // Only cells above index and in runs above its own are consulted, so
+        // index is not memoized in the meantime.
+        bool const result = is_seeded(index) || run_is_reached(index);
+        is_reached.insert(std::make_pair(index, result));
+        return result;
+    }
+
+private:
+    typedef boost::unordered_map< index_t, bool > memo_type;
+
+    State const & state;
+    memo_type is_reached;
+    // Keyed by the first cell of each run.
+    memo_type run_is_reached_;
+
+    bool is_seeded(index_t const index)
+    { return is_movable_rock(state[index]) || (*this)(index + 'U'); }
+
+    bool run_is_reached(index_t first_index)
+    {
+        while(!is_unmovable(state[first_index + 'L']))
+            first_index += 'L';
+        typename memo_type::const_iterator const it =
+            run_is_reached_.find(first_index);
+        if(it != run_is_reached_.end())
+            return it->second;
+        bool result = false;
+        for(index_t index = first_index;
+            !is_unmovable(state[index + 'R']); index += 'R') {
+            if(index != first_index && is_seeded(index)) {
+                result = true;
+                break;
+            }
+        }
+        run_is_reached_.insert(std::make_pair(first_index, result));
+        return result;
+    }
+};
+
+} // namespace simplify_ip_detail
+
+// Marks the rocks which are unmovable (see rock_is_unmovable) once the cells of
+// candidates have changed, and so on for the rocks near those: a rock's status
+// depends only on the cells up to one row below it and from one column left
+// to two columns right.  Cells are changed through assign(index, cell), after
+// which state must read cell at index.  The marked rocks are appended to
+// marked_indices.
+template< class State, class Assign >
+void mark_unmovable_rocks(
+    State const & state,
+    std::deque< index_t >& candidates,
+    std::vector< index_t >& marked_indices,
+    Assign& assign)
+{
+    while(!candidates.empty()) {
+        index_t const changed_index = candidates.front();
+        candidates.pop_front();
+        std::size_t const changed_i = changed_index.i();
+        std::size_t const changed_j = changed_index.j();
+        std::size_t const first_j = std::max< std::size_t >(changed_j, 2) - 2;
+        for(std::size_t i = changed_i-1; i != changed_i+1; ++i) {
+            for(std::size_t j = first_j; j != changed_j+2; ++j) {
+                index_t const index(i,j);
+                if(!is_movable_rock(state[index])
+                || !rock_is_unmovable(state, index))
+                    continue;
+                assign(index, '+');
+                marked_indices.push_back(index);
+                candidates.push_back(index);
+            }
+        }
+    }
+}
+
+// Simplifies state as state_t::simplify_ip does, given that it was simplified
+// before the cells of changes were changed (from the cells paired with them),
+// by re-evaluating only what those changes may affect: the rocks near them
+// (see mark_unmovable_rocks), and the earth (if simplify_earth) which the
+// rocks that have since left their cells or become unmovable could reach.
+// Only the cells so visited are recorded, so the cost does not grow with the
+// size of the map.  Cells are changed through assign as for
+// mark_unmovable_rocks.
+template< class State, class Assign >
+void simplify_ip(
+    State const & state,
+    std::vector< std::pair< index_t, char > > const & changes,
+    bool const simplify_earth,
+    Assign assign)
+{
+    typedef std::pair< index_t, char > change_type;
+
+    // Identify unmovable rocks ('+').
+    std::vector< index_t > lost_rock_indices;
+    std::deque< index_t > candidates;
+    BOOST_FOREACH( change_type const change, changes ) {
+        index_t const index = change.first;
+        if(is_movable_rock(change.second) && !is_movable_rock(state[index]))
+            lost_rock_indices.push_back(index);
+        candidates.push_back(index);
+    }
+    mark_unmovable_rocks(state, candidates, lost_rock_indices, assign);
+
+    if(!simplify_earth || lost_rock_indices.empty())
+        return;
+
+    // Identify earth ('.') which may be safely set to empty space (' '): all
+    // the cells a lost rock reached lie in its run, or in the runs below it,
+    // and those below a cell still reached are still reached.
+    simplify_ip_detail::reached_t< State > reached(state);
+    boost::unordered_set< index_t > visited;
+    std::vector< index_t > earth_indices;
+    BOOST_FOREACH( index_t const lost_index, lost_rock_indices ) {
+        candidates.push_back(lost_index + 'L');
+        candidates.push_back(lost_index + 'R');
+        candidates.push_back(lost_index + 'D');
+    }
+    while(!candidates.empty()) {
+        index_t index = candidates.front();
+        candidates.pop_front();
+        if(is_unmovable(state[index]) || visited.count(index) != 0)
+            continue;
+        while(!is_unmovable(state[index + 'L']))
+            index += 'L';
+        for(; !is_unmovable(state[index]); index += 'R') {
+            if(!visited.insert(index).second)
+                continue;
+            if(reached(index))
+                continue;
+            if(state[index] == '.')
+                earth_indices.push_back(index);
+            candidates.push_back(index + 'D');
+        }
+    }
+    BOOST_FOREACH( index_t const index, earth_indices )
+        assign(index, ' ');
+}
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_SIMPLIFY_IP_HPP
@@ -9,34 +9,25 @@
 #include <cassert>
 #include <cstddef>
 
+#include <algorithm>
 #include <deque>
 #include <iostream>
-#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include <boost/foreach.hpp>
-#include <boost/unordered_set.hpp>
 
+#include "active_set_t.hpp"
 #include "cell_is_active.hpp"
 #include "index_t.hpp"
+#include "simplify_ip.hpp"
 #include "state_t.hpp"
-#include "update_compare_t.hpp"
 #include "update_rock.hpp"
 
 namespace icfp2012
 {
 
-namespace
-{
-
-inline bool
-is_unmovable(char const cell)
-{ return cell == '#' || cell == '+' || cell == 'L' || cell == 'O'; }
-
-} // namespace
-
 /*******************************************************************************
  * state_t::initialize(std::istream& is) -> void
  ******************************************************************************/
@@ -45,8 +36,6 @@ void
 state_t::
 initialize(std::istream& is)
 {
-    n_cells = 0;
-
     n_turns = 0;
     n_lambdas_remaining = 0;
     n_lambdas_collected = 0;
@@ -61,14 +50,24 @@ initialize(std::istream& is)
 
     std::string s;
 
+    std::vector< std::string > lines;
+    std::size_t n_map_cols = 0;
     while(std::getline(is, s).good() && !s.empty()) {
-        n_cells += s.size();
-        cells.push_back(std::vector< char >());
-        cells.back().reserve(s.size());
-        cells.back().insert(cells.back().end(), s.begin(), s.end());
+        if(n_map_cols < s.size())
+            n_map_cols = s.size();
+        lines.push_back(s);
+    }
+
+    n_rows = lines.size() + 2;
+    n_cols = n_map_cols + 2;
+    cells.assign(n_rows * n_cols, '#');
+    for(std::size_t i = 0; i != lines.size(); ++i) {
+        char* const row = operator[](i+1) + 1;
+        std::fill(row, row + n_map_cols, ' ');
+        std::copy(lines[i].begin(), lines[i].end(), row);
     }
 
-    water_level = cells.size();
+    water_level = n_rows - 1;
 
     std::vector< std::size_t > trampoline_map_targets(9);
     std::vector< std::vector< std::size_t > > target_map_trampolines(9);
@@ -106,10 +105,10 @@ initialize(std::istream& is)
     bool robot_found = false;
     bool lift_found = false;
 
-    for(std::size_t i = 0; i != cells.size(); ++i) {
-        for(std::size_t j = 0; j != cells[i].size(); ++j) {
+    for(std::size_t i = 1; i != n_rows - 1; ++i) {
+        for(std::size_t j = 1; j != n_cols - 1; ++j) {
             index_t index(i,j);
-            char const cell = cells[i][j];
+            char const cell = operator[](i)[j];
             switch(cell) {
             case 'R':
                 assert(!robot_found);
@@ -129,18 +128,18 @@ initialize(std::istream& is)
             case '*':
             case 'W':
                 if(cell_is_active(*this, index))
-                    active_indices.push_back(index);
+                    active_indices.insert(index);
                 break;
             default:
                 if('A' <= cell && cell <= 'I') {
                     std::size_t const trampoline = trampoline_map_t::as_i(cell);
                     std::size_t const target = trampoline_map_targets[trampoline];
-                    target_map[target].push_back(index);
+                    target_map[target_map_t::as_c(target)].push_back(index);
                 }
                 else if('1' <= cell && cell <= '9') {
                     std::size_t const target = target_map_t::as_i(cell);
                     BOOST_FOREACH( std::size_t const trampoline, target_map_trampolines[target] )
-                        trampoline_map[trampoline] = index;
+                        trampoline_map[trampoline_map_t::as_c(trampoline)] = index;
                 }
             }
         }
@@ -148,59 +147,80 @@ initialize(std::istream& is)
 
     assert(robot_found);
     assert(lift_found);
+
+    n_beards = static_cast< unsigned int >(
+        std::count(cells.begin(), cells.end(), 'W'));
+
+    features = 0;
+    if(water_level != n_rows - 1 || flooding_rate != 0)
+        features |= feature_e_water;
+    if(n_razors != 0
+    || n_beards != 0
+    || std::find(cells.begin(), cells.end(), '!') != cells.end())
+        features |= feature_e_beards;
+    for(std::size_t i = 0; i != 9; ++i)
+        if(!target_map.trampolines[i].empty())
+            features |= feature_e_trampolines;
+    if(std::find(cells.begin(), cells.end(), '@') != cells.end())
+        features |= feature_e_lambda_rocks;
 }
 
 /*******************************************************************************
- * state_t::simplify_ip() -> void
+ * struct state_t::assign_t
+ ******************************************************************************/
+
+struct state_t::assign_t
+{
+    state_t& state;
+    undo_t* undo;
+
+    assign_t(state_t& state_, undo_t* const undo_)
+        : state(state_), undo(undo_)
+    { }
+
+    void operator()(index_t const index, char const cell) const
+    { state.assign_(index, cell, undo); }
+};
+
+/*******************************************************************************
+ * state_t::simplify_ip_(undo_t* const undo) -> void
  ******************************************************************************/
 
 void
 state_t::
-simplify_ip()
+simplify_ip_(undo_t* const undo)
 {
-    // Identify unmovable rocks ('+').
+    // Identify unmovable rocks ('+').  A rock may only turn out to be unmovable
+    // once a rock right of it has been marked, so those marked in the sweep
+    // are revisited.
     bool beard_found = false;
-    std::size_t n_cols = 0;
-    for(std::size_t i = cells.size() - 2; i != 0; --i) {
-        if(n_cols < cells[i].size())
-            n_cols = cells[i].size();
-        for(std::size_t j = 0; j != cells[i].size(); ++j) {
-            char& cell = cells[i][j];
+    std::deque< index_t > marked_indices;
+    for(std::size_t i = n_rows - 2; i != 0; --i) {
+        for(std::size_t j = 1; j != n_cols - 1; ++j) {
+            index_t const index(i,j);
+            char const cell = operator[](index);
             if(cell == 'W')
                 beard_found = true;
-            if(!(cell == '*' || cell == '@'))
-                continue;
-            char const cellD = cells[i+1][j];
-            if(!is_unmovable(cellD))
+            if(!is_movable_rock(cell) || !rock_is_unmovable(*this, index))
                 continue;
-            assert(0 < j && j < cells[i].size() - 1);
-            char const cellL = cells[i][j-1];
-            char const cellDL = cells[i+1][j-1];
-            char const cellR = cells[i][j+1];
-            char const cellDR = cells[i+1][j+1];
-            if((cellD != '+'
-             || ((is_unmovable(cellL) || is_unmovable(cellDL))
-              && (is_unmovable(cellR) || is_unmovable(cellDR))))
-            && (is_unmovable(cellL)
-             || is_unmovable(cellR)
-             || ((cellR == '*' || cellR == '@')
-              && is_unmovable(cellDR)
-              && (cellDR != '+'
-               || is_unmovable(cells[i][j+2])
-               || is_unmovable(cells[i+1][j+2])))))
-                cell = '+';
+            assign_(index, '+', undo);
+            marked_indices.push_back(index);
         }
     }
+    std::vector< index_t > revisited_indices;
+    assign_t assign(*this, undo);
+    mark_unmovable_rocks(*this, marked_indices, revisited_indices, assign);
 
     if(beard_found)
         return;
 
     // Identify earth ('.') which may be safely set to empty space (' ').
     std::vector< bool > earth_mask(n_cols, false);
-    for(std::size_t i = 0; i != cells.size(); ++i) {
+    for(std::size_t i = 1; i != n_rows - 1; ++i) {
+        char* const row = operator[](i);
         bool b = false;
-        for(std::size_t j = 0; j != cells[i].size(); ++j) {
-            char const cell = cells[i][j];
+        for(std::size_t j = 1; j != n_cols - 1; ++j) {
+            char const cell = row[j];
             if(is_unmovable(cell)) {
                 earth_mask[j] = b = false;
                 continue;
@@ -214,35 +234,82 @@ simplify_ip()
                     continue;
                 earth_mask[j] = true;
             }
-            if(is_unmovable(cells[i][j-1]) || is_unmovable(cells[i][j+1]))
+            if(is_unmovable(row[j-1]) || is_unmovable(row[j+1]))
                 continue;
             b = true;
             for(std::size_t k = j; k != 0;) {
                 --k;
-                if(earth_mask[k] || is_unmovable(cells[i][k]))
+                if(earth_mask[k] || is_unmovable(row[k]))
                     break;
                 earth_mask[k] = true;
             }
         }
-        for(std::size_t j = 0; j != cells[i].size(); ++j) {
-            char& cell = cells[i][j];
-            if(cell == '.' && !earth_mask[j])
-                cell = ' ';
-        }
+        for(std::size_t j = 1; j != n_cols - 1; ++j)
+            if(row[j] == '.' && !earth_mask[j])
+                assign_(index_t(i,j), ' ', undo);
+    }
+}
+
+/*******************************************************************************
+ * state_t::simplify_ip(undo_t& undo) -> void
+ ******************************************************************************/
+
+void
+state_t::
+simplify_ip(undo_t& undo)
+{
+    typedef std::pair< std::size_t, char > offset_cell_type;
+    std::vector< std::pair< index_t, char > > changes;
+    changes.reserve(undo.cells.size());
+    bool beard_lost = false;
+    BOOST_FOREACH( offset_cell_type const offset_cell, undo.cells ) {
+        std::size_t const offset = offset_cell.first;
+        changes.push_back(std::make_pair(
+            index_t(offset / n_cols, offset % n_cols), offset_cell.second));
+        if(offset_cell.second == 'W')
+            beard_lost = true;
+    }
+    bool const beard_found = n_beards != 0;
+    // Earth is left alone while there are beards, so once the last is shaved
+    // all of it must be simplified.
+    if(beard_lost && !beard_found) {
+        simplify_ip_(&undo);
+        return;
     }
+    icfp2012::simplify_ip(
+        *this, changes, !beard_found, assign_t(*this, &undo));
 }
 
 /*******************************************************************************
- * state_t::move_robot_update(char const move) -> void
+ * state_t::move_robot_update_ip_< Features >(
+ *     char const move,
+ *     undo_t* const undo)
+ *     -> void
  ******************************************************************************/
 
+template< class Features >
 void
 state_t::
-move_robot_update_ip(char const move)
+move_robot_update_ip_(char const move, undo_t* const undo)
 {
     assert(!robot_is_destroyed);
     assert(move != 'A');
 
+    if(undo) {
+        undo->cells.clear();
+        undo->active_indices.swap(active_indices);
+        undo->robot_index = robot_index;
+        undo->n_lambdas_remaining = n_lambdas_remaining;
+        undo->n_lambdas_collected = n_lambdas_collected;
+        undo->robot_is_destroyed = robot_is_destroyed;
+        undo->water_level = water_level;
+        undo->n_turns_underwater = n_turns_underwater;
+        undo->n_razors = n_razors;
+        undo->n_beards = n_beards;
+    }
+    active_set_t const & old_active_indices =
+        undo ? undo->active_indices : active_indices;
+
     ++n_turns;
 
     std::deque< index_t > new_empty_indices;
@@ -253,14 +320,14 @@ move_robot_update_ip(char const move)
     case 'W':
         break;
     case 'S':
-        if(n_razors == 0)
+        if(!Features::beards || n_razors == 0)
             break;
         --n_razors;
-        for(std::size_t i = robot_index.i-1; i != robot_index.i+2; ++i) {
-            for(std::size_t j = robot_index.j-1; j != robot_index.j+2; ++j) {
-                if(cells[i][j] != 'W')
+        for(std::size_t i = robot_index.i()-1; i != robot_index.i()+2; ++i) {
+            for(std::size_t j = robot_index.j()-1; j != robot_index.j()+2; ++j) {
+                if(operator[](i)[j] != 'W')
                     continue;
-                cells[i][j] = ' ';
+                assign_(index_t(i,j), ' ', undo);
                 new_empty_indices.push_back(index_t(i,j));
             }
         }
@@ -271,10 +338,10 @@ move_robot_update_ip(char const move)
         switch(dest_cell) {
         case '*':
         case '@': {
-            char& other_cell = operator[](dest_index + move);
-            if(!(move == 'L' || move == 'R') || other_cell != ' ')
+            index_t const other_index = dest_index + move;
+            if(!(move == 'L' || move == 'R') || operator[](other_index) != ' ')
                 break;
-            other_cell = dest_cell;
+            assign_(other_index, dest_cell, undo);
             rock_is_moved = true;
             goto CASE_COMMON;
         }
@@ -290,42 +357,45 @@ move_robot_update_ip(char const move)
         case ' ':
             goto CASE_COMMON;
         default:
-            if(!('A' <= dest_cell && dest_cell <= 'I'))
+            if(!Features::trampolines
+            || !('A' <= dest_cell && dest_cell <= 'I'))
                 break;
             dest_index = trampoline_map[dest_cell];
             BOOST_FOREACH(
                 index_t const trampoline_index,
                 target_map[operator[](dest_index)] ) {
-                char& trampoline_cell = operator[](trampoline_index);
+                char const trampoline_cell = operator[](trampoline_index);
                 if(!('A' <= trampoline_cell && trampoline_cell <= 'I'))
                     continue;
-                trampoline_cell = ' ';
+                assign_(trampoline_index, ' ', undo);
                 new_empty_indices.push_back(trampoline_index);
             }
         CASE_COMMON:
-            operator[](robot_index) = ' ';
+            assign_(robot_index, ' ', undo);
             new_empty_indices.push_back(robot_index);
-            operator[](dest_index) = 'R';
+            assign_(dest_index, 'R', undo);
             robot_index = dest_index;
         }
     }}
 
-    if(flooding_rate != 0 && (n_turns % flooding_rate) == 0 && water_level != 0)
+    if(Features::water
+    && flooding_rate != 0 && (n_turns % flooding_rate) == 0 && water_level != 0)
         --water_level;
 
-    bool const grow_beards = beard_growth_rate != 0
+    bool const grow_beards = Features::beards
+                          && beard_growth_rate != 0
                           && (n_turns % beard_growth_rate == 0);
 
-    boost::unordered_set< index_t > old_active_beards;
+    active_set_t old_active_beards;
 
     // Determine which cells need updating.
-    std::set< index_t, update_compare_t > update_srces;
+    active_set_t update_srces;
     if(rock_is_moved) {
         index_t const index = robot_index + move;
         if(cell_is_active(*this, index))
             update_srces.insert(index);
     }
-    BOOST_FOREACH( index_t const index, active_indices) {
+    BOOST_FOREACH( index_t const index, old_active_indices ) {
         if(cell_is_active(*this, index)) {
             if(grow_beards || operator[](index) != 'W')
                 update_srces.insert(index);
@@ -336,10 +406,8 @@ move_robot_update_ip(char const move)
     active_indices.clear();
     BOOST_FOREACH( index_t const index, new_empty_indices) {
         assert(operator[](index) == ' ');
-        for(std::size_t i = index.i-1; i != index.i+2; ++i) {
-            for(std::size_t j = index.j-1; j != index.j+2; ++j) {
-                if(j >= cells[i].size())
-                    continue;
+        for(std::size_t i = index.i()-1; i != index.i()+2; ++i) {
+            for(std::size_t j = index.j()-1; j != index.j()+2; ++j) {
                 index_t const adj_index(i,j);
                 if(cell_is_active(*this, adj_index)){
                     if(grow_beards || operator[](adj_index) != 'W')
@@ -365,14 +433,15 @@ move_robot_update_ip(char const move)
                 break;
             update_dests.push_back(update_type(index, ' '));
             update_dests.push_back(update_type(dest_index,
-                cell == '@' && operator[](dest_index + 'D') != ' ' ? '\\' : cell));
+                Features::lambda_rocks && cell == '@'
+             && operator[](dest_index + 'D') != ' ' ? '\\' : cell));
             break;
         }
         case 'W':
             assert(grow_beards);
-            for(std::size_t i = index.i-1; i != index.i+2; ++i)
-                for(std::size_t j= index.j-1; j != index.j+2; ++j)
-                    if(cells[i][j] == ' ')
+            for(std::size_t i = index.i()-1; i != index.i()+2; ++i)
+                for(std::size_t j= index.j()-1; j != index.j()+2; ++j)
+                    if(operator[](i)[j] == ' ')
                         update_dests.push_back(update_type(index_t(i,j), 'W'));
             break;
         default:
@@ -386,7 +455,7 @@ move_robot_update_ip(char const move)
     BOOST_FOREACH( update_type const update, update_dests ) {
         index_t const index = update.first;
         char const cell = update.second;
-        operator[](index) = cell;
+        assign_(index, cell, undo);
         if(operator[](index + 'D') == 'R') {
             assert(cell != '@');
             robot_is_destroyed = cell == '*' || cell == '\\';
@@ -394,47 +463,95 @@ move_robot_update_ip(char const move)
     }
 
     // Determine new set of active cells.
-    boost::unordered_set< index_t > active_indices_hash;
     BOOST_FOREACH( index_t const index, old_active_beards )
         if(cell_is_active(*this, index))
-            active_indices_hash.insert(index);
+            active_indices.insert(index);
     old_active_beards.clear();
     BOOST_FOREACH( update_type const update, update_dests ) {
         index_t const index = update.first;
         char const cell = update.second;
         assert(operator[](index) == cell);
         if(cell == ' '){
-            for(std::size_t i = index.i-1; i != index.i+2; ++i) {
-                for(std::size_t j = index.j-1; j != index.j+2; ++j) {
-                    if(j >= cells[i].size())
-                        continue;
+            for(std::size_t i = index.i()-1; i != index.i()+2; ++i) {
+                for(std::size_t j = index.j()-1; j != index.j()+2; ++j) {
                     index_t const adj_index(i,j);
                     if(cell_is_active(*this, adj_index))
-                        active_indices_hash.insert(adj_index);
+                        active_indices.insert(adj_index);
                 }
             }
         }
         else if(cell_is_active(*this, index))
-            active_indices_hash.insert(index);
+            active_indices.insert(index);
     }
     update_dests.clear();
-    active_indices.insert(
-        active_indices.end(),
-        active_indices_hash.begin(), active_indices_hash.end());
 
     // Check special conditions.
     if(robot_index == lift_index)
         robot_is_destroyed = false;
     else {
-        if(n_lambdas_remaining == 0)
-            operator[](lift_index) = 'O';
-        if(robot_index.i < water_level)
+        if(n_lambdas_remaining == 0 && operator[](lift_index) != 'O')
+            assign_(lift_index, 'O', undo);
+        if(!Features::water)
+            assert(n_turns_underwater == 0);
+        else if(robot_index.i() < water_level)
             n_turns_underwater = 0;
         else if(++n_turns_underwater > waterproof)
             robot_is_destroyed = true;
     }
 }
 
+/*******************************************************************************
+ * state_t::move_robot_update_ip_(char const move, undo_t* const undo) -> void
+ ******************************************************************************/
+
+struct state_t::move_robot_update_ip_t
+{
+    state_t& state;
+    char move;
+    undo_t* undo;
+
+    move_robot_update_ip_t(
+        state_t& state_, char const move_, undo_t* const undo_)
+        : state(state_), move(move_), undo(undo_)
+    { }
+
+    typedef void result_type;
+
+    template< class Features >
+    void apply() const
+    { state.move_robot_update_ip_< Features >(move, undo); }
+};
+
+void
+state_t::
+move_robot_update_ip_(char const move, undo_t* const undo)
+{ dispatch_features(features, move_robot_update_ip_t(*this, move, undo)); }
+
+/*******************************************************************************
+ * state_t::undo_move_ip(undo_t& undo) -> void
+ ******************************************************************************/
+
+void
+state_t::
+undo_move_ip(undo_t& undo)
+{
+    typedef std::pair< std::size_t, char > offset_cell_type;
+    BOOST_REVERSE_FOREACH( offset_cell_type const offset_cell, undo.cells )
+        cells[offset_cell.first] = offset_cell.second;
+    undo.cells.clear();
+    active_indices.swap(undo.active_indices);
+
+    --n_turns;
+    robot_index = undo.robot_index;
+    n_lambdas_remaining = undo.n_lambdas_remaining;
+    n_lambdas_collected = undo.n_lambdas_collected;
+    robot_is_destroyed = undo.robot_is_destroyed;
+    water_level = undo.water_level;
+    n_turns_underwater = undo.n_turns_underwater;
+    n_razors = undo.n_razors;
+    n_beards = undo.n_beards;
+}
+
 /*******************************************************************************
  * operator<<(std::ostream& o, char const move) -> std::ostream&
  ******************************************************************************/
@@ -445,13 +562,17 @@ operator<<(std::ostream& o, state_t const & this_)
     o << "After " << this_.n_turns << " turns: " << std::endl;
     o << "Turns underwater: " << this_.n_turns_underwater << std::endl;
 
-    for(std::size_t i = 0; i != this_.cells.size(); ++i) {
-        if(i == this_.water_level) {
-            for(std::size_t j = 0; j != this_.cells[i].size(); ++j)
+    // Rows above the first map row are always dry, so water at level 0 is
+    // displayed just above the first map row.
+    std::size_t const water_level =
+        std::max< std::size_t >(this_.water_level, 1);
+    for(std::size_t i = 1; i != this_.n_rows - 1; ++i) {
+        if(i == water_level) {
+            for(std::size_t j = 1; j != this_.n_cols - 1; ++j)
                 o << '~';
             o << std::endl;
         }
-        for(std::size_t j = 0; j != this_.cells[i].size(); ++j)
+        for(std::size_t j = 1; j != this_.n_cols - 1; ++j)
             o << this_[i][j];
         o << std::endl;
     }
@@ -14,10 +14,13 @@
 
 #include <deque>
 #include <iosfwd>
+#include <utility>
 #include <vector>
 
 #include <boost/foreach.hpp>
 
+#include "active_set_t.hpp"
+#include "feature_e.hpp"
 #include "index_t.hpp"
 #include "move_is_valid.hpp"
 
@@ -26,12 +29,16 @@ namespace icfp2012
 
 struct state_t
 {
-    std::vector< std::vector< char > > cells;
-    std::size_t n_cells;
+    // Row-major cells, surrounded by a border of walls ('#') and with ragged
+    // map lines padded out with empty space (' '), so that every cell within
+    // the map has all 8 neighbors and rows are n_cols apart.
+    std::vector< char > cells;
+    std::size_t n_rows;
+    std::size_t n_cols;
 
     index_t robot_index;
     index_t lift_index;
-    std::deque< index_t > active_indices;
+    active_set_t active_indices;
 
     unsigned int n_turns;
     unsigned int n_lambdas_remaining;
@@ -45,6 +52,12 @@ struct state_t
 
     unsigned int beard_growth_rate;
     unsigned int n_razors;
+    // The number of beards ('W') among cells, maintained by assign_.
+    unsigned int n_beards;
+
+    // The feature_e's of the map, which the simulators are specialized for.
+    // A state derived from this one never uses more.
+    unsigned int features;
 
     struct trampoline_map_t
     {
@@ -66,10 +79,12 @@ struct state_t
         std::vector< index_t > const & operator[](char const c) const;
     } target_map;
 
+    std::size_t offset(index_t const index) const;
+
     char& operator[](index_t const index);
     char operator[](index_t const index) const;
-    std::vector< char >& operator[](std::size_t const i);
-    std::vector< char > const & operator[](std::size_t const i) const;
+    char* operator[](std::size_t const i);
+    char const * operator[](std::size_t const i) const;
 
     int score() const;
 
@@ -81,6 +96,45 @@ struct state_t
 
     void move_robot_update_ip(char const move);
     void move_robot_update_ip(std::deque< char > const & moves);
+
+    // Everything move_robot_update_ip changes, recorded so that the move can
+    // be reversed by undo_move_ip.  Reusing an undo_t for many moves (e.g.,
+    // one per depth of a depth-first search) reuses its buffers.
+    struct undo_t
+    {
+        std::vector< std::pair< std::size_t, char > > cells;
+        active_set_t active_indices;
+
+        index_t robot_index;
+        unsigned int n_lambdas_remaining;
+        unsigned int n_lambdas_collected;
+        bool robot_is_destroyed;
+        unsigned int water_level;
+        unsigned int n_turns_underwater;
+        unsigned int n_razors;
+        unsigned int n_beards;
+    };
+
+    void move_robot_update_ip(char const move, undo_t& undo);
+    // As simplify_ip(), but only around the cells changed by the move which
+    // recorded undo, given that the state was simplified before the move.
+    // The cells this changes are recorded in undo too, so undo_move_ip
+    // restores them along with the move's.
+    void simplify_ip(undo_t& undo);
+    // Restores the state preceding the move_robot_update_ip which recorded
+    // undo, in time proportional to the number of cells it changed.  Moves
+    // must be undone in the reverse order they were made.
+    void undo_move_ip(undo_t& undo);
+
+private:
+    struct assign_t;
+    struct move_robot_update_ip_t;
+
+    void simplify_ip_(undo_t* const undo);
+    void assign_(index_t const index, char const cell, undo_t* const undo);
+    void move_robot_update_ip_(char const move, undo_t* const undo);
+    template< class Features >
+    void move_robot_update_ip_(char const move, undo_t* const undo);
 };
 
 std::ostream& operator<<(std::ostream& o, state_t const & this_);
@@ -90,25 +144,39 @@ std::ostream& operator<<(std::ostream& o, state_t::target_map_t const & this_);
 /*******************************************************************************
  ******************************************************************************/
 
+inline std::size_t
+state_t::
+offset(index_t const index) const
+{
+    assert(index.i() < n_rows && index.j() < n_cols);
+    return index.i() * n_cols + index.j();
+}
+
 inline char&
 state_t::
 operator[](index_t const index)
-{ return cells[index.i][index.j]; }
+{ return cells[offset(index)]; }
 
 inline char
 state_t::
 operator[](index_t const index) const
-{ return cells[index.i][index.j]; }
+{ return cells[offset(index)]; }
 
-inline std::vector< char >&
+inline char*
 state_t::
 operator[](std::size_t const i)
-{ return cells[i]; }
+{
+    assert(i < n_rows);
+    return &cells[i * n_cols];
+}
 
-inline std::vector< char > const &
+inline char const *
 state_t::
 operator[](std::size_t const i) const
-{ return cells[i]; }
+{
+    assert(i < n_rows);
+    return &cells[i * n_cols];
+}
 
 inline int
 state_t::
@@ -125,6 +193,16 @@ state_t::
 move_is_valid(char const move) const
 { return icfp2012::move_is_valid(*this, move); }
 
+inline void
+state_t::
+simplify_ip()
+{ simplify_ip_(0); }
+
+inline void
+state_t::
+move_robot_update_ip(char const move)
+{ move_robot_update_ip_(move, 0); }
+
 inline void
 state_t::
 move_robot_update_ip(std::deque< char > const & moves)
@@ -133,6 +211,25 @@ move_robot_update_ip(std::deque< char > const & moves)
         move_robot_update_ip(move);
 }
 
+inline void
+state_t::
+move_robot_update_ip(char const move, undo_t& undo)
+{ move_robot_update_ip_(move, &undo); }
+
+inline void
+state_t::
+assign_(index_t const index, char const cell, undo_t* const undo)
+{
+    char& this_cell = operator[](index);
+    if(undo)
+        undo->cells.push_back(std::make_pair(offset(index), this_cell));
+    if(this_cell == 'W')
+        --n_beards;
+    if(cell == 'W')
+        ++n_beards;
+    this_cell = cell;
+}
+
 /*******************************************************************************
  ******************************************************************************/
 
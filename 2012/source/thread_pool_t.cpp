@@ -0,0 +1,151 @@
+/*******************************************************************************
+ * icfp/2012/source/thread_pool_t.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/detail/atomic_count.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "thread_pool_t.hpp"
+
+namespace icfp2012
+{
+
+/*******************************************************************************
+ * thread_pool_t::thread_pool_t(std::size_t n_threads)
+ ******************************************************************************/
+
+thread_pool_t::
+thread_pool_t(std::size_t n_threads_)
+    : n_threads(
+          n_threads_ != 0 ? n_threads_ :
+          std::max< std::size_t >(boost::thread::hardware_concurrency(), 1)),
+      generation(0),
+      n_running(0),
+      is_stopping(false),
+      f(0),
+      n(0),
+      chunk_size(1),
+      n_chunks_claimed(new boost::detail::atomic_count(0))
+{
+    for(std::size_t thread_index = 1; thread_index != n_threads; ++thread_index)
+        threads.create_thread(
+            boost::bind(&thread_pool_t::work, this, thread_index));
+}
+
+/*******************************************************************************
+ * thread_pool_t::~thread_pool_t()
+ ******************************************************************************/
+
+thread_pool_t::
+~thread_pool_t()
+{
+    {
+        boost::lock_guard< boost::mutex > lock(mutex);
+        is_stopping = true;
+    }
+    start_condition.notify_all();
+    threads.join_all();
+}
+
+/*******************************************************************************
+ * thread_pool_t::for_each_index(
+ *     std::size_t const n,
+ *     function_type const & f,
+ *     std::size_t const chunk_size)
+ *     -> void
+ ******************************************************************************/
+
+void
+thread_pool_t::
+for_each_index(
+    std::size_t const n_,
+    function_type const & f_,
+    std::size_t const chunk_size_ /*= 1*/)
+{
+    assert(chunk_size_ != 0);
+    if(n_ == 0)
+        return;
+    if(n_threads == 1 || n_ <= chunk_size_) {
+        for(std::size_t k = 0; k != n_; ++k)
+            f_(k, 0);
+        return;
+    }
+    {
+        boost::lock_guard< boost::mutex > lock(mutex);
+        assert(!f);
+        f = &f_;
+        n = n_;
+        chunk_size = chunk_size_;
+        n_chunks_claimed.reset(new boost::detail::atomic_count(0));
+        n_running = n_threads - 1;
+        ++generation;
+    }
+    start_condition.notify_all();
+    run(0);
+    boost::unique_lock< boost::mutex > lock(mutex);
+    while(n_running != 0)
+        done_condition.wait(lock);
+    f = 0;
+}
+
+/*******************************************************************************
+ * thread_pool_t::work(std::size_t const thread_index) -> void
+ ******************************************************************************/
+
+void
+thread_pool_t::
+work(std::size_t const thread_index)
+{
+    unsigned long last_generation = 0;
+    while(true) {
+        {
+            boost::unique_lock< boost::mutex > lock(mutex);
+            while(!is_stopping && generation == last_generation)
+                start_condition.wait(lock);
+            if(is_stopping)
+                return;
+            last_generation = generation;
+        }
+        run(thread_index);
+        bool is_last;
+        {
+            boost::lock_guard< boost::mutex > lock(mutex);
+            is_last = --n_running == 0;
+        }
+        if(is_last)
+            done_condition.notify_one();
+    }
+}
+
+/*******************************************************************************
+ * thread_pool_t::run(std::size_t const thread_index) -> void
+ ******************************************************************************/
+
+void
+thread_pool_t::
+run(std::size_t const thread_index)
+{
+    while(true) {
+        std::size_t const first =
+            static_cast< std::size_t >(++*n_chunks_claimed - 1) * chunk_size;
+        if(first >= n)
+            return;
+        std::size_t const last = std::min(first + chunk_size, n);
+        for(std::size_t k = first; k != last; ++k)
+            (*f)(k, thread_index);
+    }
+}
+
+} // namespace icfp2012
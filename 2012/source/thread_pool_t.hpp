@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * icfp/2012/source/thread_pool_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_THREAD_POOL_T_HPP
+#define ICFP_2012_SOURCE_THREAD_POOL_T_HPP
+
+#include <cstddef>
+
+#include <boost/detail/atomic_count.hpp>
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace icfp2012
+{
+
+// A fixed set of threads which cooperatively run a loop over indices.  The
+// thread calling for_each_index takes part, so a pool of size 1 starts no
+// threads and runs everything inline.
+class thread_pool_t
+{
+public:
+    typedef boost::function< void ( std::size_t, std::size_t ) > function_type;
+
+    // A size of 0 means one thread per hardware thread.
+    explicit thread_pool_t(std::size_t n_threads = 0);
+    ~thread_pool_t();
+
+    std::size_t size() const;
+
+    // Calls f(k, thread_index) for each k in [0, n), with thread_index in
+    // [0, size()) identifying the calling thread, and returns once all calls
+    // have returned.  Threads claim indices in chunks of chunk_size from a
+    // shared counter, so uneven work balances itself.  Not reentrant.
+    void for_each_index(
+        std::size_t const n,
+        function_type const & f,
+        std::size_t const chunk_size = 1);
+
+private:
+    thread_pool_t(thread_pool_t const &);
+    thread_pool_t& operator=(thread_pool_t const &);
+
+    std::size_t const n_threads;
+    boost::thread_group threads;
+
+    boost::mutex mutex;
+    boost::condition_variable start_condition;
+    boost::condition_variable done_condition;
+    unsigned long generation;
+    std::size_t n_running;
+    bool is_stopping;
+
+    function_type const * f;
+    std::size_t n;
+    std::size_t chunk_size;
+    boost::scoped_ptr< boost::detail::atomic_count > n_chunks_claimed;
+
+    void work(std::size_t const thread_index);
+    void run(std::size_t const thread_index);
+};
+
+/*******************************************************************************
+ ******************************************************************************/
+
+inline std::size_t
+thread_pool_t::
+size() const
+{ return n_threads; }
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_THREAD_POOL_T_HPP
@@ -0,0 +1,344 @@
+/*******************************************************************************
+ * icfp/2012/source/transposition_table_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_TRANSPOSITION_TABLE_T_HPP
+#define ICFP_2012_SOURCE_TRANSPOSITION_TABLE_T_HPP
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "arena_t.hpp"
+
+namespace icfp2012
+{
+
+// An open-addressing (linear probing) hash table from 64-bit fingerprints
+// (e.g., delta_t::partial_hash) to buckets of values, which must be trivially
+// copyable (e.g., pointers to visited states).  The first few values of a
+// bucket are stored inline in its slot; larger buckets spill into an array
+// allocated from an arena_t.
+//
+// The slot array doubles as needed up to max_bytes.  Once it can grow no
+// further and is 3/4 full, lookups probe at most max_probes slots, and a
+// fingerprint not found among them takes an empty one or else replaces the
+// least recently used bucket among them, so the memory used by the table is
+// bounded.
+template< class T >
+class transposition_table_t
+{
+public:
+    static std::size_t const n_inline_values = 3;
+    static std::size_t const max_probes = 8;
+
+    class bucket_t;
+
+    transposition_table_t(arena_t& arena_, std::size_t const max_bytes);
+
+    // Returns the bucket of fingerprint, which is empty if fingerprint was
+    // not in the table.  The reference is invalidated by the next call.
+    bucket_t& operator[](boost::uint64_t fingerprint);
+    // Returns the bucket of fingerprint, or 0 if fingerprint is not in the
+    // table.  Does not modify the table, so concurrent calls are safe.
+    bucket_t const * find(boost::uint64_t fingerprint) const;
+
+    std::size_t size() const;
+    std::size_t capacity() const;
+    std::size_t n_evictions() const;
+
+private:
+    arena_t& arena;
+    std::size_t const max_slots;
+    std::vector< bucket_t > slots;
+    std::size_t n_used;
+    std::size_t n_evictions_;
+    boost::uint32_t stamp;
+
+    static std::size_t floor_pow2(std::size_t const n);
+
+    void grow();
+};
+
+/*******************************************************************************
+ ******************************************************************************/
+
+template< class T >
+class transposition_table_t< T >::bucket_t
+{
+public:
+    typedef T value_type;
+
+    bucket_t();
+
+    std::size_t size() const;
+    bool empty() const;
+
+    T& operator[](std::size_t const k);
+    T const & operator[](std::size_t const k) const;
+
+    void push_back(T const x);
+    void pop_back();
+    // Replaces the k-th value by the last, so does not preserve order.
+    void erase(std::size_t const k);
+
+private:
+    friend class transposition_table_t;
+
+    // 0 marks an empty slot.
+    boost::uint64_t fingerprint;
+    boost::uint32_t stamp;
+    boost::uint32_t size_;
+    boost::uint32_t capacity;
+    arena_t* arena;
+    T inline_values[n_inline_values];
+    T* values;
+
+    T* data();
+    T const * data() const;
+    void clear();
+};
+
+/*******************************************************************************
+ ******************************************************************************/
+
+template< class T >
+inline
+transposition_table_t< T >::
+transposition_table_t(arena_t& arena_, std::size_t const max_bytes)
+    : arena(arena_),
+      max_slots(floor_pow2(std::max< std::size_t >(
+          max_bytes / sizeof( bucket_t ), 2 * max_probes))),
+      slots(std::min< std::size_t >(1024, max_slots)),
+      n_used(0),
+      n_evictions_(0),
+      stamp(0)
+{ }
+
+template< class T >
+typename transposition_table_t< T >::bucket_t&
+transposition_table_t< T >::
+operator[](boost::uint64_t fingerprint)
+{
+    if(fingerprint == 0)
+        fingerprint = 1;
+    ++stamp;
+    // Grow at 1/2 full while below capacity; stop filling at 3/4 once there.
+    if(2 * (n_used + 1) > slots.size() && 2 * slots.size() <= max_slots)
+        grow();
+    bool const is_full = 4 * (n_used + 1) > 3 * slots.size();
+    std::size_t const mask = slots.size() - 1;
+    std::size_t k = static_cast< std::size_t >(fingerprint) & mask;
+    bucket_t* victim = 0;
+    for(std::size_t n_probes = 0;
+        !is_full || n_probes != max_probes;
+        ++n_probes, k = (k + 1) & mask) {
+        bucket_t& bucket = slots[k];
+        if(bucket.fingerprint == fingerprint) {
+            bucket.stamp = stamp;
+            return bucket;
+        }
+        if(bucket.fingerprint == 0) {
+            ++n_used;
+            bucket.fingerprint = fingerprint;
+            bucket.stamp = stamp;
+            bucket.arena = &arena;
+            return bucket;
+        }
+        if(!victim || stamp - bucket.stamp > stamp - victim->stamp)
+            victim = &bucket;
+    }
+    assert(victim);
+    ++n_evictions_;
+    victim->clear();
+    victim->fingerprint = fingerprint;
+    victim->stamp = stamp;
+    return *victim;
+}
+
+template< class T >
+typename transposition_table_t< T >::bucket_t const *
+transposition_table_t< T >::
+find(boost::uint64_t fingerprint) const
+{
+    if(fingerprint == 0)
+        fingerprint = 1;
+    bool const is_full = 4 * (n_used + 1) > 3 * slots.size();
+    std::size_t const mask = slots.size() - 1;
+    std::size_t k = static_cast< std::size_t >(fingerprint) & mask;
+    for(std::size_t n_probes = 0;
+        !is_full || n_probes != max_probes;
+        ++n_probes, k = (k + 1) & mask) {
+        bucket_t const & bucket = slots[k];
+        if(bucket.fingerprint == fingerprint)
+            return &bucket;
+        if(bucket.fingerprint == 0)
+            return 0;
+    }
+    return 0;
+}
+
+template< class T >
+inline std::size_t
+transposition_table_t< T >::
+size() const
+{ return n_used; }
+
+template< class T >
+inline std::size_t
+transposition_table_t< T >::
+capacity() const
+{ return slots.size(); }
+
+template< class T >
+inline std::size_t
+transposition_table_t< T >::
+n_evictions() const
+{ return n_evictions_; }
+
+template< class T >
+inline std::size_t
+transposition_table_t< T >::
+floor_pow2(std::size_t const n)
+{
+    std::size_t result = 1;
+    while(2 * result <= n)
+        result *= 2;
+    return result;
+}
+
+template< class T >
+void
+transposition_table_t< T >::
+grow()
+{
+    std::vector< bucket_t > old_slots(2 * slots.size());
+    old_slots.swap(slots);
+    std::size_t const mask = slots.size() - 1;
+    for(std::size_t k = 0; k != old_slots.size(); ++k) {
+        bucket_t const & bucket = old_slots[k];
+        if(bucket.fingerprint == 0)
+            continue;
+        std::size_t l = static_cast< std::size_t >(bucket.fingerprint) & mask;
+        while(slots[l].fingerprint != 0)
+            l = (l + 1) & mask;
+        slots[l] = bucket;
+    }
+}
+
+/*******************************************************************************
+ ******************************************************************************/
+
+template< class T >
+inline
+transposition_table_t< T >::bucket_t::
+bucket_t()
+    : fingerprint(0),
+      stamp(0),
+      size_(0),
+      capacity(n_inline_values),
+      arena(0),
+      values(0)
+{ }
+
+template< class T >
+inline std::size_t
+transposition_table_t< T >::bucket_t::
+size() const
+{ return size_; }
+
+template< class T >
+inline bool
+transposition_table_t< T >::bucket_t::
+empty() const
+{ return size_ == 0; }
+
+template< class T >
+inline T*
+transposition_table_t< T >::bucket_t::
+data()
+{ return capacity == n_inline_values ? inline_values : values; }
+
+template< class T >
+inline T const *
+transposition_table_t< T >::bucket_t::
+data() const
+{ return capacity == n_inline_values ? inline_values : values; }
+
+template< class T >
+inline T&
+transposition_table_t< T >::bucket_t::
+operator[](std::size_t const k)
+{
+    assert(k < size_);
+    return data()[k];
+}
+
+template< class T >
+inline T const &
+transposition_table_t< T >::bucket_t::
+operator[](std::size_t const k) const
+{
+    assert(k < size_);
+    return data()[k];
+}
+
+template< class T >
+inline void
+transposition_table_t< T >::bucket_t::
+push_back(T const x)
+{
+    if(size_ == capacity) {
+        T* const new_values =
+            static_cast< T* >(arena->allocate(2 * capacity * sizeof( T )));
+        std::copy(data(), data() + size_, new_values);
+        if(capacity != n_inline_values)
+            arena->deallocate(values, capacity * sizeof( T ));
+        values = new_values;
+        capacity *= 2;
+    }
+    data()[size_++] = x;
+}
+
+template< class T >
+inline void
+transposition_table_t< T >::bucket_t::
+pop_back()
+{
+    assert(size_ != 0);
+    --size_;
+}
+
+template< class T >
+inline void
+transposition_table_t< T >::bucket_t::
+erase(std::size_t const k)
+{
+    assert(k < size_);
+    T* const values_ = data();
+    values_[k] = values_[--size_];
+}
+
+template< class T >
+inline void
+transposition_table_t< T >::bucket_t::
+clear()
+{
+    if(capacity != n_inline_values)
+        arena->deallocate(values, capacity * sizeof( T ));
+    size_ = 0;
+    capacity = n_inline_values;
+    values = 0;
+}
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_TRANSPOSITION_TABLE_T_HPP
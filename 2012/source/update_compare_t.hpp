@@ -18,7 +18,7 @@ struct update_compare_t
 {
     typedef bool result_type;
     bool operator()(index_t const index0, index_t const index1) const
-    { return index0.i > index1.i || index0.i == index1.i && index0.j < index1.j; }
+    { return index0.i() > index1.i() || index0.i() == index1.i() && index0.j() < index1.j(); }
 };
 
 } // namespace icfp2012
@@ -0,0 +1,109 @@
+/*******************************************************************************
+ * icfp/2012/source/update_source_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_UPDATE_SOURCE_T_HPP
+#define ICFP_2012_SOURCE_UPDATE_SOURCE_T_HPP
+
+#include <cassert>
+#include <cstddef>
+
+#include <utility>
+#include <vector>
+
+#include "cell_is_active.hpp"
+#include "feature_e.hpp"
+#include "index_t.hpp"
+#include "update_compare_t.hpp"
+#include "update_rock.hpp"
+
+namespace icfp2012
+{
+
+typedef std::pair< index_t, char > cell_update_t;
+
+// How the world update treats a cell, which depends only on the cells at most
+// two rows and columns away from it.  Its updates are updates[first_update]
+// through updates[first_update + n_updates - 1] of some vector of updates.
+struct update_source_t
+{
+    index_t index;
+    bool is_active;
+    // Active beards are only updated on the turns they grow.
+    bool is_updated;
+    std::size_t first_update;
+    std::size_t n_updates;
+};
+
+struct update_source_compare_t
+{
+    typedef bool result_type;
+    bool operator()(
+        update_source_t const & source0,
+        update_source_t const & source1) const
+    { return update_compare_t()(source0.index, source1.index); }
+};
+
+struct update_source_equal_t
+{
+    typedef bool result_type;
+    bool operator()(
+        update_source_t const & source0,
+        update_source_t const & source1) const
+    { return source0.index == source1.index; }
+};
+
+// Classifies the cell at index of state, appending its updates (if any) to
+// updates, under the rules of the features of Features (see feature_e).
+template< class Features, class State >
+update_source_t classify_source(
+    State const & state,
+    index_t const index,
+    bool const grow_beards,
+    std::vector< cell_update_t >& updates)
+{
+    update_source_t source;
+    source.index = index;
+    source.is_active = cell_is_active(state, index);
+    source.is_updated =
+        source.is_active && (grow_beards || state[index] != 'W');
+    source.first_update = updates.size();
+    if(source.is_updated) {
+        char const cell = state[index];
+        switch(cell) {
+        case '*':
+        case '@': {
+            index_t const dest_index = update_rock(state, index);
+            if(dest_index == index)
+                break;
+            updates.push_back(cell_update_t(index, ' '));
+            updates.push_back(cell_update_t(dest_index,
+                Features::lambda_rocks
+             && cell == '@' && state[dest_index + 'D'] != ' ' ? '\\' : cell));
+            break;
+        }
+        case 'W':
+            assert(Features::beards && grow_beards);
+            for(std::size_t i = index.i()-1; i != index.i()+2; ++i) {
+                for(std::size_t j = index.j()-1; j != index.j()+2; ++j) {
+                    index_t const adj_index(i,j);
+                    if(state[adj_index] == ' ')
+                        updates.push_back(cell_update_t(adj_index, 'W'));
+                }
+            }
+            break;
+        default:
+            assert(false);
+        }
+    }
+    source.n_updates = updates.size() - source.first_update;
+    return source;
+}
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_UPDATE_SOURCE_T_HPP
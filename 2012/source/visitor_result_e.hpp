@@ -15,6 +15,8 @@ namespace icfp2012
 enum visitor_result_e
 {
     visitor_result_e_continue,
+    // Keep the state (so it may still dominate others) but do not expand it.
+    visitor_result_e_prune,
     visitor_result_e_skip,
     visitor_result_e_return
 };
@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * icfp/2012/source/world_timeline_t.cpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#include <cstddef>
+
+#include <boost/foreach.hpp>
+
+#include "delta_t.hpp"
+#include "feature_e.hpp"
+#include "index_t.hpp"
+#include "update_source_t.hpp"
+#include "world_timeline_t.hpp"
+
+namespace icfp2012
+{
+
+/*******************************************************************************
+ * world_timeline_t::world_timeline_t(
+ *     delta_t const & start,
+ *     bool const simplify,
+ *     std::size_t const max_n_frames)
+ ******************************************************************************/
+
+world_timeline_t::
+world_timeline_t(
+    delta_t const & start,
+    bool const simplify /*= false*/,
+    std::size_t const max_n_frames /*= 1024*/)
+    : first_n_turns(start.n_turns)
+{
+    delta_t world(start);
+    world.cell_map.set_arena(0);
+    world.robot_is_destroyed = false;
+    while(frames.size() != max_n_frames) {
+        frames.push_back(frame_t(world));
+        if(world.active_indices.empty())
+            break;
+        frame_t& frame = frames.back();
+        bool const grow_beards =
+            world.base.beard_growth_rate != 0
+         && (world.n_turns + 1) % world.base.beard_growth_rate == 0;
+        BOOST_FOREACH( index_t const index, world.active_indices ) {
+            update_source_t const source = classify_source< all_features_t >(
+                world, index, grow_beards, frame.updates);
+            if(source.is_updated)
+                frame.sources.push_back(source);
+        }
+        delta_t next = world.move_robot_update('W');
+        next.robot_is_destroyed = false;
+        if(simplify)
+            next.simplify_ip(world);
+        world.swap(next);
+    }
+}
+
+} // namespace icfp2012
@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * icfp/2012/source/world_timeline_t.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_WORLD_TIMELINE_T_HPP
+#define ICFP_2012_SOURCE_WORLD_TIMELINE_T_HPP
+
+#include <cstddef>
+
+#include <deque>
+#include <vector>
+
+#include "delta_t.hpp"
+#include "update_source_t.hpp"
+
+namespace icfp2012
+{
+
+// The world of a game turn by turn as it evolves while the robot waits where
+// it is, from a start state on.  Rocks and beards away from the robot evolve
+// the same whatever it does, so a later state of the game differs from the
+// frame of its turn only around the cells the robot has changed, and the world
+// update of the state need only be computed there (see
+// delta_t::move_robot_update).
+//
+// Frames are recorded until the world comes to rest or for max_n_frames turns,
+// whichever is sooner.  If simplify, each frame is simplified (see
+// delta_t::simplify_ip) from the one before, for searches which simplify their
+// states, and start must be simplified too.  Frames share the cells of start,
+// so start's overlay (and any arena it is allocated from) must outlive the
+// timeline.
+class world_timeline_t
+{
+public:
+    struct frame_t
+    {
+        // The robot never moves, but it is never destroyed either.
+        delta_t world;
+        // The sources of world which are updated on the following turn, and
+        // their updates.
+        std::vector< update_source_t > sources;
+        std::vector< cell_update_t > updates;
+
+        explicit frame_t(delta_t const & world_);
+    };
+
+    explicit world_timeline_t(
+        delta_t const & start,
+        bool const simplify = false,
+        std::size_t const max_n_frames = 1024);
+
+    // Returns 0 if n_turns is outside the recorded frames.
+    frame_t const * frame(unsigned int const n_turns) const;
+
+private:
+    unsigned int first_n_turns;
+    // The elements of a deque do not move as it grows at the end.
+    std::deque< frame_t > frames;
+};
+
+/*******************************************************************************
+ ******************************************************************************/
+
+inline
+world_timeline_t::frame_t::
+frame_t(delta_t const & world_)
+    : world(world_)
+{ }
+
+inline world_timeline_t::frame_t const *
+world_timeline_t::
+frame(unsigned int const n_turns) const
+{
+    if(n_turns < first_n_turns || n_turns - first_n_turns >= frames.size())
+        return 0;
+    return &frames[n_turns - first_n_turns];
+}
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_WORLD_TIMELINE_T_HPP
@@ -0,0 +1,41 @@
+/*******************************************************************************
+ * icfp/2012/source/zobrist_key.hpp
+ *
+ * Copyright 2012, Jeffrey Hellrung.
+ * Distributed under the Boost Software License, Version 1.0.  (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ ******************************************************************************/
+
+#ifndef ICFP_2012_SOURCE_ZOBRIST_KEY_HPP
+#define ICFP_2012_SOURCE_ZOBRIST_KEY_HPP
+
+#include <cstddef>
+
+#include <boost/cstdint.hpp>
+
+namespace icfp2012
+{
+
+// Scrambles x into a 64-bit key (the splitmix64 finalizer).  Used in place of
+// a table of random Zobrist keys, which would have to be sized to the map.
+inline boost::uint64_t
+zobrist_mix(boost::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// The Zobrist key of cell occupying the cell at offset (see state_t::offset).
+inline boost::uint64_t
+zobrist_key(std::size_t const offset, char const cell)
+{
+    return zobrist_mix(
+        static_cast< boost::uint64_t >(offset) << 8
+      | static_cast< unsigned char >(cell));
+}
+
+} // namespace icfp2012
+
+#endif // #ifndef ICFP_2012_SOURCE_ZOBRIST_KEY_HPP